@@ -0,0 +1,196 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <errno.h>
+
+namespace dromozoa {
+  namespace {
+    template <class T>
+    void erase(std::map<std::string, T>& map, std::list<std::string>& lru, typename std::map<std::string, T>::iterator i) {
+      lru.erase(i->second.position);
+      map.erase(i);
+    }
+
+    template <class T>
+    void erase(std::map<std::string, T>& map, std::list<std::string>& lru, const std::string& prefix) {
+      typename std::map<std::string, T>::iterator i = map.lower_bound(prefix);
+      if (i != map.end() && i->first == prefix) {
+        erase(map, lru, i++);
+      }
+      while (i != map.end() && i->first.compare(0, prefix.size(), prefix) == 0) {
+        if (is_descendant(i->first, prefix)) {
+          erase(map, lru, i++);
+        } else {
+          ++i;
+        }
+      }
+    }
+
+    // makes room for a new path by evicting the least recently used one.
+    template <class T>
+    bool reserve(std::map<std::string, T>& map, std::list<std::string>& lru, size_t max_size, const std::string& path) {
+      if (max_size > 0 && map.size() >= max_size && map.find(path) == map.end()) {
+        erase(map, lru, map.find(lru.back()));
+        return true;
+      }
+      return false;
+    }
+
+    template <class T>
+    T& insert(std::map<std::string, T>& map, std::list<std::string>& lru, const std::string& path) {
+      typename std::map<std::string, T>::iterator i = map.find(path);
+      if (i == map.end()) {
+        lru.push_front(path);
+        T& that = map[path];
+        that.position = lru.begin();
+        return that;
+      }
+      lru.splice(lru.begin(), lru, i->second.position);
+      return i->second;
+    }
+  }
+
+  attr_cache::attr_cache(const struct options& options)
+    : max_size_(options.attr_cache_size),
+      negative_timeout_(options.negative_timeout),
+      max_negative_size_(options.negative_cache_size),
+      generations_(),
+      hits_(),
+      misses_(),
+      negative_hits_(),
+      negative_misses_(),
+      invalidations_(),
+      evictions_() {}
+
+  uint64_t attr_cache::generation() {
+    lock_guard<> lock(mutex_);
+    return generations_.get();
+  }
+
+  // a path which was not found is answered with -ENOENT in result.  a hit
+  // makes the entry the most recently used.
+  bool attr_cache::get(const char* path, struct stat* buffer, int* result) {
+    lock_guard<> lock(mutex_);
+    double t = now();
+    std::map<std::string, entry>::iterator i = map_.find(path);
+    if (i != map_.end()) {
+      if (i->second.expires > t) {
+        lru_.splice(lru_.begin(), lru_, i->second.position);
+        *buffer = i->second.attr;
+        *result = 0;
+        ++hits_;
+        return true;
+      }
+      erase(map_, lru_, i);
+    }
+    if (!negative_map_.empty()) {
+      std::map<std::string, negative_entry>::iterator j = negative_map_.find(path);
+      if (j != negative_map_.end()) {
+        if (j->second.expires > t) {
+          negative_lru_.splice(negative_lru_.begin(), negative_lru_, j->second.position);
+          *result = -ENOENT;
+          ++negative_hits_;
+          return true;
+        }
+        erase(negative_map_, negative_lru_, j);
+      }
+    }
+    ++misses_;
+    return false;
+  }
+
+  // the entry is dropped if the path was invalidated after the handler was
+  // called, since the attributes may be older than the invalidation.
+  void attr_cache::put(const char* path, const struct stat& attr, double ttl, uint64_t generation) {
+    if (ttl <= 0) {
+      return;
+    }
+    lock_guard<> lock(mutex_);
+    if (!generations_.valid(path, generation)) {
+      return;
+    }
+    if (reserve(map_, lru_, max_size_, path)) {
+      ++evictions_;
+    }
+    entry& that = insert(map_, lru_, path);
+    that.attr = attr;
+    that.expires = now() + ttl;
+  }
+
+  void attr_cache::put_negative(const char* path, uint64_t generation) {
+    if (negative_timeout_ <= 0) {
+      return;
+    }
+    lock_guard<> lock(mutex_);
+    ++negative_misses_;
+    if (!generations_.valid(path, generation)) {
+      return;
+    }
+    if (reserve(negative_map_, negative_lru_, max_negative_size_, path)) {
+      ++evictions_;
+    }
+    insert(negative_map_, negative_lru_, path).expires = now() + negative_timeout_;
+  }
+
+  // removes the path, and its descendants which may have been renamed.  a
+  // path created by mknod, mkdir, symlink, link, rename or create is removed
+  // from the paths which were not found.
+  void attr_cache::invalidate(const char* path, bool descendants) {
+    std::string prefix(path);
+    lock_guard<> lock(mutex_);
+    generations_.invalidate(prefix, descendants);
+    ++invalidations_;
+    if (descendants) {
+      erase(map_, lru_, prefix);
+      erase(negative_map_, negative_lru_, prefix);
+    } else {
+      std::map<std::string, entry>::iterator i = map_.find(prefix);
+      if (i != map_.end()) {
+        erase(map_, lru_, i);
+      }
+      std::map<std::string, negative_entry>::iterator j = negative_map_.find(prefix);
+      if (j != negative_map_.end()) {
+        erase(negative_map_, negative_lru_, j);
+      }
+    }
+  }
+
+  void attr_cache::invalidate() {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate();
+    ++invalidations_;
+    map_.clear();
+    lru_.clear();
+    negative_map_.clear();
+    negative_lru_.clear();
+  }
+
+  void attr_cache::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "entries", map_.size());
+    luaX_set_field(L, -1, "hits", hits_);
+    luaX_set_field(L, -1, "misses", misses_);
+    luaX_set_field(L, -1, "negative_entries", negative_map_.size());
+    luaX_set_field(L, -1, "negative_hits", negative_hits_);
+    luaX_set_field(L, -1, "negative_misses", negative_misses_);
+    luaX_set_field(L, -1, "invalidations", invalidations_);
+    luaX_set_field(L, -1, "evictions", evictions_);
+  }
+}
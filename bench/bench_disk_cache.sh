@@ -0,0 +1,38 @@
+#! /bin/sh -e
+
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+# the same file is read on a mount with an empty disk cache and again on a
+# new mount that finds the chunk files of the first.
+
+DROMOZOA_FUSE_DISK_CACHE_DIR=`mktemp -d`
+export DROMOZOA_FUSE_DISK_CACHE_DIR
+
+for DROMOZOA_FUSE_BENCH_PHASE in cold warm
+do
+  export DROMOZOA_FUSE_BENCH_PHASE
+  if ./bench/_runner bench/disk_cache.lua bench/disk_cache.sh mount_point "$@"
+  then
+    :
+  else
+    rm -fr "$DROMOZOA_FUSE_DISK_CACHE_DIR"
+    exit 1
+  fi
+done
+
+rm -fr "$DROMOZOA_FUSE_DISK_CACHE_DIR"
@@ -0,0 +1,83 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+-- reads of a file from a slow backend, where each block costs a fixed
+-- latency, through the disk cache in DROMOZOA_FUSE_DISK_CACHE_DIR.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local size = tonumber(os.getenv "DROMOZOA_FUSE_BENCH_SIZE" or 16 * 1024 * 1024)
+local latency = tonumber(os.getenv "DROMOZOA_FUSE_BENCH_LATENCY" or 0.002)
+local dir = assert(os.getenv "DROMOZOA_FUSE_DISK_CACHE_DIR")
+local data = ("0123456789abcdef"):rep(size / 16)
+
+local operations = {}
+
+local root = {
+  st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+  st_nlink = 2;
+}
+
+local file = {
+  st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+  st_nlink = 1;
+  st_size = #data;
+}
+
+function operations:getattr(path)
+  if path == "/" then
+    return root
+  elseif path == "/data" then
+    return file
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:open(path, info)
+  if path == "/data" then
+    return 0, "etag-1"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:read(path, size, offset)
+  unix.nanosleep(latency)
+  return data:sub(offset + 1, offset + size)
+end
+
+function operations:statfs(path)
+  return {}
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "data"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations), {
+  disk_cache_dir = dir;
+  disk_cache_size = size * 2;
+})
+assert(result == 0)
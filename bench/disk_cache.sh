@@ -0,0 +1,38 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+lua - "$mount_point" "$DROMOZOA_FUSE_BENCH_PHASE" <<'EOH'
+local unix = require "dromozoa.unix"
+
+local mount_point, phase = ...
+
+local n = 0
+local t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber()
+local handle = assert(io.open(mount_point .. "/data", "rb"))
+while true do
+  local data = handle:read(131072)
+  if not data then
+    break
+  end
+  n = n + #data
+end
+handle:close()
+t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber() - t
+io.write(("%-6s %d bytes %.3f sec %.3f MiB/sec\n"):format(phase, n, t, n / t / 1048576))
+EOH
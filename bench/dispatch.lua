@@ -0,0 +1,62 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+-- getattr storm against a trivial file system; every stat reaches the handler
+-- because the kernel attribute and entry caches are disabled.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local operations = {}
+
+local root = {
+  st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+  st_nlink = 2;
+}
+
+local file = {
+  st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+  st_nlink = 1;
+  st_size = 0;
+}
+
+function operations:getattr(path)
+  if path == "/" then
+    return root
+  elseif path == "/file" then
+    return file
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:statfs(path)
+  return {}
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "file"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], "-o", "attr_timeout=0,entry_timeout=0,negative_timeout=0", ... }, fuse.state_manager.main(operations))
+assert(result == 0)
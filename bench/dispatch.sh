@@ -0,0 +1,35 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+count=${DROMOZOA_FUSE_BENCH_COUNT-100000}
+
+lua - "$mount_point" "$count" <<'EOH'
+local unix = require "dromozoa.unix"
+
+local mount_point, count = ...
+local path = mount_point .. "/file"
+count = tonumber(count)
+
+local t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber()
+for i = 1, count do
+  assert(unix.stat(path))
+end
+t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber() - t
+
+io.write(("getattr %d calls %.3f sec %.3f usec/call\n"):format(count, t, t / count * 1000000))
+EOH
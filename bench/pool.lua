@@ -0,0 +1,74 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+
+-- getattr storm served by a pool; every call opens and closes a pooled state.
+-- DROMOZOA_FUSE_BENCH_AFFINITY=1 enables thread-affine sticky states.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+if arg then
+  local handle = assert(io.open(arg[0]))
+  local chunk = handle:read "*a"
+  handle:close()
+  local options = {
+    affinity = tonumber(os.getenv "DROMOZOA_FUSE_BENCH_AFFINITY" or 0);
+  }
+  local result = fuse.main({ arg[0], "-o", "attr_timeout=0,entry_timeout=0,negative_timeout=0", ... }, fuse.state_manager.pool(64, 64, 64, chunk, arg[0], options))
+  assert(result == 0)
+  return
+end
+
+local operations = {}
+
+local root = {
+  st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+  st_nlink = 2;
+}
+
+local file = {
+  st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+  st_nlink = 1;
+  st_size = 0;
+}
+
+function operations:getattr(path)
+  if path == "/" then
+    return root
+  elseif path == "/file" then
+    return file
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:statfs(path)
+  return {}
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "file"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+return operations
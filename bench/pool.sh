@@ -0,0 +1,50 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+
+mount_point=$1
+count=${DROMOZOA_FUSE_BENCH_COUNT-100000}
+
+now() {
+  lua -e "local unix = require 'dromozoa.unix' print(unix.clock_gettime(unix.CLOCK_MONOTONIC):tostring())"
+}
+
+for threads in 1 2 4 8 16 32 64
+do
+  n=`expr "$count" / "$threads"`
+  t=`now`
+  pids=
+  i=0
+  while test "$i" -lt "$threads"
+  do
+    lua -e "
+local unix = require 'dromozoa.unix'
+for i = 1, $n do
+  assert(unix.stat('$mount_point/file'))
+end
+" &
+    pids="$pids $!"
+    i=`expr "$i" + 1`
+  done
+  wait $pids
+  lua -e "
+local unix = require 'dromozoa.unix'
+local t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber() - $t
+local count = $n * $threads
+io.write(('threads %2d %d calls %.3f sec %.0f calls/sec\n'):format($threads, count, t, count / t))
+"
+done
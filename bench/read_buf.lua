@@ -0,0 +1,86 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+
+-- sequential reads of a file served by read returning strings and of the same
+-- file served by read_buf returning the file descriptor of a backing file.
+-- direct_io keeps the page cache out of the way and splice_write lets libfuse
+-- splice the backing file to the device.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local size = tonumber(os.getenv "DROMOZOA_FUSE_BENCH_SIZE" or 64 * 1024 * 1024)
+local data = ("0123456789abcdef"):rep(size / 16)
+
+local filename = os.tmpname()
+local out = assert(io.open(filename, "w"))
+out:write(data)
+out:close()
+local fd = assert(unix.open(filename, unix.O_RDONLY))
+os.remove(filename)
+
+local operations = {}
+
+local root = {
+  st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+  st_nlink = 2;
+}
+
+local file = {
+  st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+  st_nlink = 1;
+  st_size = #data;
+}
+
+function operations:getattr(path)
+  if path == "/" then
+    return root
+  elseif path == "/string" or path == "/fd" then
+    return file
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:read(path, size, offset)
+  return data:sub(offset + 1, offset + size)
+end
+
+function operations:read_buf(path, size, offset)
+  if path == "/fd" then
+    return fd:get(), offset, math.max(#data - offset, 0)
+  end
+end
+
+function operations:statfs(path)
+  return {}
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "string"
+    fill "fd"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], "-o", "direct_io,splice_write,splice_move", ... }, fuse.state_manager.main(operations))
+assert(result == 0)
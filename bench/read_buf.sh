@@ -0,0 +1,46 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+
+mount_point=$1
+count=${DROMOZOA_FUSE_BENCH_COUNT-10}
+
+lua - "$mount_point" "$count" <<'EOH'
+local unix = require "dromozoa.unix"
+
+local mount_point, count = ...
+count = tonumber(count)
+
+for _, name in ipairs { "string", "fd" } do
+  local path = mount_point .. "/" .. name
+  local n = 0
+  local t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber()
+  for i = 1, count do
+    local handle = assert(io.open(path, "rb"))
+    while true do
+      local data = handle:read(131072)
+      if not data then
+        break
+      end
+      n = n + #data
+    end
+    handle:close()
+  end
+  t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber() - t
+  io.write(("%-6s %d bytes %.3f sec %.3f MiB/sec\n"):format(name, n, t, n / t / 1048576))
+end
+EOH
@@ -0,0 +1,59 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+
+-- time to construct a pool of N ready states from a large handler module,
+-- with all standard libraries and with a minimal set.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local size = tonumber(os.getenv "DROMOZOA_FUSE_BENCH_SIZE" or 5000)
+
+local buffer = { "local operations = {}\n" }
+for i = 1, size do
+  buffer[#buffer + 1] = ([[
+function operations:handler%d(path, a, b)
+  local t = { path = path, a = a, b = b, n = %d }
+  if a then
+    return t.path .. tostring(t.a) .. tostring(t.n)
+  else
+    return b
+  end
+end
+]]):format(i, i)
+end
+buffer[#buffer + 1] = "return operations\n"
+local chunk = table.concat(buffer)
+
+local function measure(n, options)
+  collectgarbage()
+  collectgarbage()
+  local t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber()
+  local manager = fuse.state_manager.pool(n, n, n, chunk, "=startup", options)
+  t = unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber() - t
+  manager = nil
+  collectgarbage()
+  collectgarbage()
+  return t
+end
+
+for _, n in ipairs { 1, 8, 32, 64 } do
+  local t1 = measure(n)
+  local t2 = measure(n, { libs = { "base", "string", "table" } })
+  io.write(("states %2d %d bytes all libs %.3f sec minimal libs %.3f sec\n"):format(n, #chunk, t1, t2))
+end
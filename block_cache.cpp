@@ -0,0 +1,220 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <algorithm>
+
+namespace dromozoa {
+  // 2Q: blocks read once enter the in queue (FIFO) and are remembered in
+  // the out queue (ghosts without data) after eviction.  a block read again
+  // while it is a ghost enters the main queue (LRU), so that a scan flushes
+  // only the in queue.
+  block_cache::block_cache(size_t block_size, size_t max_bytes)
+    : block_size_(block_size > 0 ? block_size : 65536),
+      max_bytes_(max_bytes),
+      max_in_bytes_(max_bytes / 4),
+      max_ghosts_(std::max<size_t>(max_bytes / block_size_ / 2, 1)),
+      in_bytes_(),
+      main_bytes_(),
+      generations_(),
+      hits_(),
+      misses_(),
+      ghost_hits_(),
+      evictions_(),
+      invalidations_() {}
+
+  size_t block_cache::block_size() const {
+    return block_size_;
+  }
+
+  uint64_t block_cache::generation() {
+    lock_guard<> lock(mutex_);
+    return generations_.get();
+  }
+
+  // does not count as a hit nor touch the block.
+  bool block_cache::contains(const std::string& path, uint64_t index) {
+    lock_guard<> lock(mutex_);
+    std::map<key_type, entry>::const_iterator i = map_.find(key_type(path, index));
+    return i != map_.end() && i->second.queue != ghost_queue;
+  }
+
+  bool block_cache::get(const std::string& path, uint64_t index, std::string* data) {
+    key_type key(path, index);
+    lock_guard<> lock(mutex_);
+    std::map<key_type, entry>::iterator i = map_.find(key);
+    if (i == map_.end() || i->second.queue == ghost_queue) {
+      ++misses_;
+      return false;
+    }
+    entry& that = i->second;
+    if (that.queue == main_queue) {
+      main_.splice(main_.begin(), main_, that.position);
+    }
+    *data = that.data;
+    ++hits_;
+    return true;
+  }
+
+  // the block is dropped if the path was invalidated after the handler was
+  // called.
+  void block_cache::put(const std::string& path, uint64_t index, const std::string& data, uint64_t generation) {
+    key_type key(path, index);
+    lock_guard<> lock(mutex_);
+    if (!generations_.valid(path, generation)) {
+      return;
+    }
+    std::map<key_type, entry>::iterator i = map_.find(key);
+    bool ghost = false;
+    if (i != map_.end()) {
+      ghost = i->second.queue == ghost_queue;
+      if (ghost) {
+        ++ghost_hits_;
+      }
+      erase(i);
+    }
+    entry& that = map_[key];
+    that.data = data;
+    if (ghost) {
+      that.queue = main_queue;
+      main_.push_front(key);
+      that.position = main_.begin();
+      main_bytes_ += data.size();
+    } else {
+      that.queue = in_queue;
+      in_.push_front(key);
+      that.position = in_.begin();
+      in_bytes_ += data.size();
+    }
+    reclaim();
+  }
+
+  // removes the blocks of the path in the range.  the short and empty blocks
+  // before the range are removed too, because they mark the end of the file
+  // that the write may extend.  readahead may have cached several of them
+  // past the end, and a full block means that none are below it.
+  void block_cache::invalidate(const std::string& path, uint64_t offset, uint64_t size) {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate(path, false);
+    ++invalidations_;
+    if (size == 0) {
+      return;
+    }
+    uint64_t first = offset / block_size_;
+    uint64_t last = (offset + size - 1) / block_size_;
+    std::map<key_type, entry>::iterator i = map_.lower_bound(key_type(path, first));
+    std::map<key_type, entry>::iterator j = i;
+    while (j != map_.begin()) {
+      --j;
+      if (j->first.first != path) {
+        break;
+      }
+      if (j->second.queue != ghost_queue) {
+        if (j->second.data.size() == block_size_) {
+          break;
+        }
+        erase(j++);
+      }
+    }
+    while (i != map_.end() && i->first.first == path && i->first.second <= last) {
+      erase(i++);
+    }
+  }
+
+  // removes the blocks of the path, and of its descendants if requested.
+  void block_cache::invalidate(const std::string& path, bool descendants) {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate(path, descendants);
+    ++invalidations_;
+    std::map<key_type, entry>::iterator i = map_.lower_bound(key_type(path, 0));
+    while (i != map_.end() && i->first.first.compare(0, path.size(), path) == 0) {
+      if (i->first.first == path || (descendants && is_descendant(i->first.first, path))) {
+        erase(i++);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  void block_cache::invalidate() {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate();
+    ++invalidations_;
+    map_.clear();
+    in_.clear();
+    main_.clear();
+    ghosts_.clear();
+    in_bytes_ = 0;
+    main_bytes_ = 0;
+  }
+
+  void block_cache::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "block_size", block_size_);
+    luaX_set_field(L, -1, "blocks", in_.size() + main_.size());
+    luaX_set_field(L, -1, "bytes", in_bytes_ + main_bytes_);
+    luaX_set_field(L, -1, "in_blocks", in_.size());
+    luaX_set_field(L, -1, "main_blocks", main_.size());
+    luaX_set_field(L, -1, "ghosts", ghosts_.size());
+    luaX_set_field(L, -1, "hits", hits_);
+    luaX_set_field(L, -1, "misses", misses_);
+    luaX_set_field(L, -1, "ghost_hits", ghost_hits_);
+    luaX_set_field(L, -1, "evictions", evictions_);
+    luaX_set_field(L, -1, "invalidations", invalidations_);
+  }
+
+  // called with mutex_ locked.
+  void block_cache::erase(std::map<key_type, entry>::iterator i) {
+    entry& that = i->second;
+    if (that.queue == in_queue) {
+      in_bytes_ -= that.data.size();
+      in_.erase(that.position);
+    } else if (that.queue == main_queue) {
+      main_bytes_ -= that.data.size();
+      main_.erase(that.position);
+    } else {
+      ghosts_.erase(that.position);
+    }
+    map_.erase(i);
+  }
+
+  // called with mutex_ locked.  the in queue gives up its oldest block while
+  // it holds more than its share, and the main queue otherwise.
+  void block_cache::reclaim() {
+    while (in_bytes_ + main_bytes_ > max_bytes_) {
+      if (!in_.empty() && (in_bytes_ > max_in_bytes_ || main_.empty())) {
+        std::map<key_type, entry>::iterator i = map_.find(in_.back());
+        entry& that = i->second;
+        in_bytes_ -= that.data.size();
+        in_.pop_back();
+        std::string().swap(that.data);
+        that.queue = ghost_queue;
+        ghosts_.push_front(i->first);
+        that.position = ghosts_.begin();
+        if (ghosts_.size() > max_ghosts_) {
+          map_.erase(ghosts_.back());
+          ghosts_.pop_back();
+        }
+      } else {
+        erase(map_.find(main_.back()));
+      }
+      ++evictions_;
+    }
+  }
+}
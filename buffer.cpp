@@ -0,0 +1,316 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace dromozoa {
+  namespace {
+    // a region is shared by a buffer and its slices.  it is invalidated when
+    // the callback returns and freed when the last buffer is collected.
+    class region {
+    public:
+      region(char* data, size_t size, bool writable)
+        : data_(data),
+          size_(size),
+          writable_(writable),
+          count_(1) {}
+
+      void reset() {
+        data_ = 0;
+      }
+
+      void add_ref() {
+        ++count_;
+      }
+
+      void release() {
+        if (--count_ == 0) {
+          delete this;
+        }
+      }
+
+      char* data() const {
+        if (!data_) {
+          luaX_throw_failure("out of scope");
+        }
+        return data_;
+      }
+
+      char* writable_data() const {
+        if (!writable_) {
+          luaX_throw_failure("read-only buffer");
+        }
+        return data();
+      }
+
+    private:
+      char* data_;
+      size_t size_;
+      bool writable_;
+      size_t count_;
+      region(const region&);
+      region& operator=(const region&);
+    };
+
+    class buffer : public handle {
+    public:
+      buffer(region* region, size_t offset, size_t size)
+        : region_(region),
+          offset_(offset),
+          size_(size) {}
+
+      ~buffer() {
+        region_->release();
+      }
+
+      virtual void reset() {
+        region_->reset();
+      }
+
+      buffer* slice(lua_State* L, size_t i, size_t j) const;
+
+      const char* data() const {
+        return region_->data() + offset_;
+      }
+
+      char* writable_data() const {
+        return region_->writable_data() + offset_;
+      }
+
+      size_t size() const {
+        return size_;
+      }
+
+    private:
+      region* region_;
+      size_t offset_;
+      size_t size_;
+      buffer(const buffer&);
+      buffer& operator=(const buffer&);
+    };
+
+    buffer* buffer::slice(lua_State* L, size_t i, size_t j) const {
+      buffer* self = luaX_new<buffer>(L, region_, offset_ + i, j - i);
+      region_->add_ref();
+      luaX_set_metatable(L, "dromozoa.fuse.buffer");
+      return self;
+    }
+
+    buffer* check_buffer(lua_State* L, int arg) {
+      return luaX_check_udata<buffer>(L, arg, "dromozoa.fuse.buffer");
+    }
+
+    void impl_gc(lua_State* L) {
+      check_buffer(L, 1)->~buffer();
+    }
+
+    void impl_len(lua_State* L) {
+      luaX_push(L, check_buffer(L, 1)->size());
+    }
+
+    void impl_get(lua_State* L) {
+      buffer* self = check_buffer(L, 1);
+      const char* data = self->data();
+      size_t size = self->size();
+      size_t i = luaX_opt_range_i(L, 2, size);
+      size_t j = luaX_opt_range_j(L, 3, size);
+      if (i < j) {
+        luaX_push(L, luaX_string_reference(data + i, j - i));
+      } else {
+        luaX_push(L, "");
+      }
+    }
+
+    // buffer:slice([i [, j]]) shares the bytes with the buffer.
+    void impl_slice(lua_State* L) {
+      buffer* self = check_buffer(L, 1);
+      self->data();
+      size_t size = self->size();
+      size_t i = luaX_opt_range_i(L, 2, size);
+      size_t j = luaX_opt_range_j(L, 3, size);
+      if (i < j) {
+        self->slice(L, i, j);
+      } else {
+        self->slice(L, 0, 0);
+      }
+    }
+
+    // buffer:crc32([i [, j [, crc]]])
+    void impl_crc32(lua_State* L) {
+      buffer* self = check_buffer(L, 1);
+      const char* data = self->data();
+      size_t size = self->size();
+      size_t i = luaX_opt_range_i(L, 2, size);
+      size_t j = luaX_opt_range_j(L, 3, size);
+      uint32_t crc = luaX_opt_integer<uint32_t>(L, 4, 0);
+      if (i < j) {
+        crc = crc32(crc, data + i, j - i);
+      }
+      luaX_push(L, crc);
+    }
+
+    // buffer:copy(position, s [, i [, j]])
+    void impl_copy(lua_State* L) {
+      buffer* self = check_buffer(L, 1);
+      char* data = self->writable_data();
+      size_t size = self->size();
+      size_t position = luaX_check_integer<size_t>(L, 2, 1, size + 1) - 1;
+      luaX_string_reference source = luaX_check_string(L, 3);
+      size_t i = luaX_opt_range_i(L, 4, source.size());
+      size_t j = luaX_opt_range_j(L, 5, source.size());
+      size_t n = 0;
+      if (i < j) {
+        n = std::min(j - i, size - position);
+        memcpy(data + position, source.data() + i, n);
+      }
+      luaX_push(L, n);
+    }
+
+    // buffer:fill(byte [, i [, j]])
+    void impl_fill(lua_State* L) {
+      buffer* self = check_buffer(L, 1);
+      char* data = self->writable_data();
+      size_t size = self->size();
+      int byte = luaX_check_integer<int>(L, 2, 0, 255);
+      size_t i = luaX_opt_range_i(L, 3, size);
+      size_t j = luaX_opt_range_j(L, 4, size);
+      size_t n = 0;
+      if (i < j) {
+        n = j - i;
+        memset(data + i, byte, n);
+      }
+      luaX_push(L, n);
+    }
+
+    // buffer:pread(fd, offset [, i [, j]]) reads until the range is filled or
+    // the end of file is reached.
+    void impl_pread(lua_State* L) {
+      buffer* self = check_buffer(L, 1);
+      char* data = self->writable_data();
+      size_t size = self->size();
+      int fd = luaX_check_integer<int>(L, 2);
+      off_t offset = luaX_check_integer<off_t>(L, 3);
+      size_t i = luaX_opt_range_i(L, 4, size);
+      size_t j = luaX_opt_range_j(L, 5, size);
+      size_t n = 0;
+      while (i + n < j) {
+        ssize_t result = ::pread(fd, data + i + n, j - i - n, offset + n);
+        if (result > 0) {
+          n += result;
+        } else if (result == 0) {
+          break;
+        } else if (errno != EINTR) {
+          int code = errno;
+          luaX_throw_failure(compat_strerror(code), code);
+        }
+      }
+      luaX_push(L, n);
+    }
+
+    size_t write_fd(int fd, const char* data, size_t size, off_t offset, bool positioned) {
+      size_t n = 0;
+      while (n < size) {
+        ssize_t result = positioned
+            ? ::pwrite(fd, data + n, size - n, offset + n)
+            : ::write(fd, data + n, size - n);
+        if (result >= 0) {
+          n += result;
+        } else if (errno != EINTR) {
+          int code = errno;
+          luaX_throw_failure(compat_strerror(code), code);
+        }
+      }
+      return n;
+    }
+
+    // buffer:write(fd [, i [, j]]) writes the bytes without making a string.
+    void impl_write(lua_State* L) {
+      buffer* self = check_buffer(L, 1);
+      const char* data = self->data();
+      size_t size = self->size();
+      int fd = luaX_check_integer<int>(L, 2);
+      size_t i = luaX_opt_range_i(L, 3, size);
+      size_t j = luaX_opt_range_j(L, 4, size);
+      size_t n = 0;
+      if (i < j) {
+        n = write_fd(fd, data + i, j - i, 0, false);
+      }
+      luaX_push(L, n);
+    }
+
+    // buffer:pwrite(fd, offset [, i [, j]])
+    void impl_pwrite(lua_State* L) {
+      buffer* self = check_buffer(L, 1);
+      const char* data = self->data();
+      size_t size = self->size();
+      int fd = luaX_check_integer<int>(L, 2);
+      off_t offset = luaX_check_integer<off_t>(L, 3);
+      size_t i = luaX_opt_range_i(L, 4, size);
+      size_t j = luaX_opt_range_j(L, 5, size);
+      size_t n = 0;
+      if (i < j) {
+        n = write_fd(fd, data + i, j - i, offset, true);
+      }
+      luaX_push(L, n);
+    }
+
+    handle* new_buffer_impl(lua_State* L, char* data, size_t size, bool writable) {
+      scoped_ptr<region> ptr(new region(data, size, writable));
+      buffer* self = luaX_new<buffer>(L, ptr.get(), 0, size);
+      ptr.release();
+      luaX_set_metatable(L, "dromozoa.fuse.buffer");
+      return self;
+    }
+  }
+
+  handle* new_buffer(lua_State* L, char* data, size_t size) {
+    return new_buffer_impl(L, data, size, true);
+  }
+
+  handle* new_buffer(lua_State* L, const char* data, size_t size) {
+    return new_buffer_impl(L, const_cast<char*>(data), size, false);
+  }
+
+  void initialize_buffer(lua_State* L) {
+    lua_newtable(L);
+    {
+      luaL_newmetatable(L, "dromozoa.fuse.buffer");
+      lua_pushvalue(L, -2);
+      luaX_set_field(L, -2, "__index");
+      luaX_set_field(L, -1, "__gc", impl_gc);
+      luaX_set_field(L, -1, "__len", impl_len);
+      lua_pop(L, 1);
+
+      luaX_set_field(L, -1, "size", impl_len);
+      luaX_set_field(L, -1, "get", impl_get);
+      luaX_set_field(L, -1, "slice", impl_slice);
+      luaX_set_field(L, -1, "crc32", impl_crc32);
+      luaX_set_field(L, -1, "copy", impl_copy);
+      luaX_set_field(L, -1, "fill", impl_fill);
+      luaX_set_field(L, -1, "pread", impl_pread);
+      luaX_set_field(L, -1, "write", impl_write);
+      luaX_set_field(L, -1, "pwrite", impl_pwrite);
+    }
+    luaX_set_field(L, -2, "buffer");
+  }
+}
@@ -1,4 +1,4 @@
-// Copyright (C) 2018-2020,2024 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2018-2020,2024,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -35,10 +35,17 @@
 #error libfuse 2.8 or newer required
 #endif
 
+#include <deque>
 #include <list>
 #include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 #include <dromozoa/bind.hpp>
+#include <dromozoa/bind/condition_variable.hpp>
+#include <dromozoa/bind/mutex.hpp>
+#include <dromozoa/bind/thread.hpp>
 
 namespace dromozoa {
   class state_manager {
@@ -46,59 +53,704 @@ namespace dromozoa {
     virtual ~state_manager() = 0;
     virtual lua_State* open() = 0;
     virtual void close(lua_State*) = 0;
+    virtual void stats(lua_State*);
+    // managers which route operations to particular states override these.
+    // path and info may be null.
+    virtual lua_State* open_route(const char*, const struct fuse_file_info*);
+    virtual void attach_handle(lua_State*, uint64_t);
+    virtual void detach_handle(uint64_t);
+    virtual bool routes_handles() const;
+    virtual bool shares_route(lua_State*, const char*, const struct fuse_file_info*);
   };
 
   state_manager* check_state_manager(lua_State*, int);
 
+  namespace dispatch {
+    enum code {
+      getattr = 1,
+      readlink,
+      mknod,
+      mkdir,
+      unlink,
+      rmdir,
+      symlink,
+      rename,
+      link,
+      chmod,
+      chown,
+      truncate,
+      open,
+      read,
+      write,
+      statfs,
+      flush,
+      release,
+      fsync,
+      setxattr,
+      getxattr,
+      listxattr,
+      removexattr,
+      opendir,
+      readdir,
+      releasedir,
+      fsyncdir,
+      init,
+      destroy,
+      access,
+      create,
+      ftruncate,
+      fgetattr,
+      lock,
+      utimens,
+      flock,
+      fallocate,
+      read_buf,
+      write_buf,
+      size
+    };
+  }
+
+  // handlers of each class may be run by their own state manager, so that
+  // slow data operations do not hold the states for metadata operations.
+  namespace operation_class {
+    enum code {
+      metadata,
+      data,
+      directory,
+      xattr,
+      lifecycle,
+      size
+    };
+  }
+
+  operation_class::code get_operation_class(dispatch::code);
+  const char* get_operation_class_name(operation_class::code);
+
+  void new_dispatch(lua_State*, int);
+
   class managed_state {
   public:
     explicit managed_state(state_manager*);
+    managed_state(state_manager*, const char*, const struct fuse_file_info*);
     ~managed_state();
     lua_State* get() const;
+    int result() const;
+    void attach(const struct fuse_file_info*);
+    void detach(const struct fuse_file_info*);
   private:
     state_manager* manager_;
     lua_State* state_;
+    int result_;
+    const struct fuse_file_info* attach_;
+    const struct fuse_file_info* detach_;
+    void open(const char*, const struct fuse_file_info*);
     managed_state(const managed_state&);
     managed_state& operator=(const managed_state&);
   };
 
+  // the generations of the caches, taken before a handler is called and
+  // checked before its result is stored, so that a result older than an
+  // invalidation of its path is dropped.  callers hold the mutex of the
+  // cache.
+  class path_generations {
+  public:
+    explicit path_generations(size_t = 4096);
+    uint64_t get() const;
+    bool valid(const std::string&, uint64_t) const;
+    void invalidate(const std::string&, bool);
+    void invalidate();
+  private:
+    size_t max_size_;
+    uint64_t sequence_;
+    uint64_t floor_;
+    std::map<std::string, uint64_t> paths_;
+    std::map<std::string, uint64_t> prefixes_;
+  };
+
+  // a value or an error returned by getxattr or listxattr.
   class xattr_cache_item {
   public:
-    xattr_cache_item(uint64_t time, const char* path, const char* data, size_t size)
+    xattr_cache_item(double time, const std::string& key, const char* data, size_t size, int result)
       : time_(time),
-        path_(path),
-        data_(data, size) {}
+        key_(key),
+        data_(data, size),
+        result_(result) {}
 
-    uint64_t time() const {
+    double time() const {
       return time_;
     }
 
+    const std::string& key() const {
+      return key_;
+    }
+
     const std::string& data() const {
       return data_;
     }
 
+    int result() const {
+      return result_;
+    }
+
   private:
-    uint64_t time_;
-    std::string path_;
+    double time_;
+    std::string key_;
     std::string data_;
+    int result_;
   };
 
+  // the values of getxattr and listxattr keyed by the path and the name,
+  // so that the probe for the size serves the following fetch.  the least
+  // recently used items are evicted to keep the data in the budget.
   class xattr_cache {
   public:
+    xattr_cache(double, size_t);
+    uint64_t generation();
+    bool get(const char*, const char*, char*, size_t, int*);
+    void put(const char*, const char*, const char*, size_t, int, uint64_t);
+    void invalidate(const char*, bool);
+    void invalidate();
+    void stats(lua_State*);
+  private:
+    typedef std::list<xattr_cache_item> list_type;
+    mutex mutex_;
+    double timeout_;
+    size_t max_bytes_;
+    size_t bytes_;
+    std::map<std::string, list_type::iterator> map_;
+    list_type list_;
+    path_generations generations_;
+    size_t hits_;
+    size_t misses_;
+    size_t evictions_;
+    void erase(std::map<std::string, list_type::iterator>::iterator);
+    xattr_cache(const xattr_cache&);
+    xattr_cache& operator=(const xattr_cache&);
+  };
+
+  // results of statfs, readlink and access which the handlers declare to
+  // be valid for a while, keyed by the path, the operation and its
+  // arguments.  the least recently used result is evicted when full.
+  class memo_cache {
+  public:
+    explicit memo_cache(size_t);
+    static std::string key(const char*, int, const std::string&);
+    uint64_t generation();
+    bool get(const std::string&, std::string*, int*);
+    void put(const std::string&, const std::string&, int, double, uint64_t);
+    void invalidate(const char*, bool);
+    void invalidate();
+    void stats(lua_State*);
+  private:
+    struct entry {
+      std::string data;
+      int result;
+      double expires;
+      std::list<std::string>::iterator position;
+    };
+    mutex mutex_;
+    size_t max_size_;
+    std::map<std::string, entry> map_;
+    std::list<std::string> lru_;
+    path_generations generations_;
+    size_t hits_;
+    size_t misses_;
+    size_t invalidations_;
+    size_t evictions_;
+    void erase(std::map<std::string, entry>::iterator);
+    memo_cache(const memo_cache&);
+    memo_cache& operator=(const memo_cache&);
+  };
+
+  // blocks returned by read, keyed by the path and the index of the block,
+  // with the 2Q replacement in a memory budget.
+  class block_cache {
+  public:
+    block_cache(size_t, size_t);
+    size_t block_size() const;
+    uint64_t generation();
+    bool contains(const std::string&, uint64_t);
+    bool get(const std::string&, uint64_t, std::string*);
+    void put(const std::string&, uint64_t, const std::string&, uint64_t);
+    void invalidate(const std::string&, uint64_t, uint64_t);
+    void invalidate(const std::string&, bool);
+    void invalidate();
+    void stats(lua_State*);
+  private:
+    typedef std::pair<std::string, uint64_t> key_type;
+    enum queue_type {
+      in_queue,
+      main_queue,
+      ghost_queue
+    };
+    struct entry {
+      queue_type queue;
+      std::list<key_type>::iterator position;
+      std::string data;
+    };
+    mutex mutex_;
+    size_t block_size_;
+    size_t max_bytes_;
+    size_t max_in_bytes_;
+    size_t max_ghosts_;
+    std::map<key_type, entry> map_;
+    std::list<key_type> in_;
+    std::list<key_type> main_;
+    std::list<key_type> ghosts_;
+    size_t in_bytes_;
+    size_t main_bytes_;
+    path_generations generations_;
+    size_t hits_;
+    size_t misses_;
+    size_t ghost_hits_;
+    size_t evictions_;
+    size_t invalidations_;
+    void erase(std::map<key_type, entry>::iterator);
+    void reclaim();
+    block_cache(const block_cache&);
+    block_cache& operator=(const block_cache&);
+  };
+
+  // blocks returned by read, kept in chunk files across mounts.  a chunk is
+  // used only while the validation token of its path is unchanged.
+  class disk_cache {
+  public:
+    disk_cache(const std::string&, size_t);
+    bool enabled() const;
+    uint64_t generation();
+    bool validate(const std::string&, const std::string&);
+    bool get(const std::string&, uint64_t, std::string*);
+    void put(const std::string&, uint64_t, const std::string&, uint64_t);
+    void invalidate(const std::string&, uint64_t, uint64_t, size_t);
+    void invalidate(const std::string&, bool);
+    void invalidate();
+    void stats(lua_State*);
+  private:
+    typedef std::pair<std::string, uint64_t> key_type;
+    struct entry {
+      std::string filename;
+      size_t size;
+      size_t data_size;
+      std::list<key_type>::iterator position;
+    };
+    struct token_entry {
+      std::string token;
+      std::list<std::string>::iterator position;
+    };
+    mutex mutex_;
+    std::string dir_;
+    size_t max_bytes_;
+    std::map<key_type, entry> map_;
+    std::list<key_type> lru_;
+    // the owner of each chunk file, since paths with the same hash share the
+    // file name.
+    std::map<std::string, key_type> files_;
+    std::map<std::string, token_entry> tokens_;
+    std::list<std::string> token_lru_;
+    size_t bytes_;
+    path_generations generations_;
+    uint64_t sequence_;
+    size_t hits_;
+    size_t misses_;
+    size_t stale_;
+    size_t corruptions_;
+    size_t writes_;
+    size_t write_errors_;
+    size_t evictions_;
+    size_t invalidations_;
+    std::string make_filename(const std::string&, uint64_t) const;
+    void erase(std::map<key_type, entry>::iterator, bool);
+    void reclaim();
+    disk_cache(const disk_cache&);
+    disk_cache& operator=(const disk_cache&);
+  };
+
+  // identical requests made while the first of them is in flight wait for
+  // it and share its result.  the keys start with the path terminated by
+  // NUL, as those of memo_cache.
+  class singleflight {
+  public:
+    struct call {
+      std::string key;
+      int result;
+      std::string data;
+      bool done;
+      bool detached;
+      size_t waiters;
+    };
+    singleflight();
+    call* join(const std::string&, int*, std::string*);
+    void done(call*, int, const std::string&);
+    void invalidate(const char*, bool);
+    void invalidate();
+    void stats(lua_State*);
+  private:
+    mutex mutex_;
+    condition_variable condition_;
+    std::map<std::string, call*> calls_;
+    size_t leaders_;
+    size_t followers_;
+    size_t detached_;
+    void detach(std::map<std::string, call*>::iterator);
+    singleflight(const singleflight&);
+    singleflight& operator=(const singleflight&);
+  };
 
+  // gathers contiguous writes to each handle, so that the handler is called
+  // once for up to max_bytes.
+  class write_coalescer {
+  public:
+    struct chunk {
+      std::string path;
+      struct fuse_file_info info;
+      off_t offset;
+      std::string data;
+      double time;
+    };
+    write_coalescer(size_t, double);
+    bool enabled() const;
+    bool add(const char*, const struct fuse_file_info*, const char*, size_t, off_t, std::vector<chunk>*);
+    void take(const char*, uint64_t, std::vector<chunk>*);
+    void take(const char*, off_t, size_t, std::vector<chunk>*);
+    void take(std::vector<chunk>*);
+    void stats(lua_State*);
   private:
-    std::map<std::string, std::string> map_;
-    std::list<std::string> list_;
+    typedef std::pair<std::string, uint64_t> key_type;
+    mutex mutex_;
+    size_t max_bytes_;
+    double max_age_;
+    std::map<key_type, chunk> map_;
+    size_t bytes_;
+    size_t writes_;
+    size_t merged_;
+    size_t flushes_;
+    size_t full_;
+    size_t aged_;
+    size_t noncontiguous_;
+    size_t overlaps_;
+    size_t barriers_;
+    void take(std::map<key_type, chunk>::iterator, std::vector<chunk>*);
+    write_coalescer(const write_coalescer&);
+    write_coalescer& operator=(const write_coalescer&);
+  };
+
+  // the context of the request which a background thread works for, seen by
+  // get_context instead of the one of fuse_get_context.  null means that
+  // the thread works for no request.
+  class scoped_context {
+  public:
+    explicit scoped_context(const struct fuse_context*);
+    ~scoped_context();
+    const struct fuse_context* get() const;
+  private:
+    const struct fuse_context* context_;
+    void* saved_;
+    scoped_context(const scoped_context&);
+    scoped_context& operator=(const scoped_context&);
+  };
+
+  // returns null when the thread works for no request.
+  const struct fuse_context* get_context();
+
+  class operations;
+
+  // batches concurrent fsync or fsyncdir calls into one call to the handler.
+  class group_commit {
+  public:
+    struct member {
+      std::string path;
+      bool has_info;
+      struct fuse_file_info info;
+      int datasync;
+      int result;
+    };
+    // calls the handler for the members and sets their results.
+    typedef void (*commit_type)(operations*, int, std::vector<member>&);
+    group_commit(int, double);
+    int commit(operations*, commit_type, const char*, int, const struct fuse_file_info*);
+    void stats(lua_State*);
+  private:
+    struct batch {
+      std::vector<member> members;
+      bool done;
+      size_t waiters;
+    };
+    mutex mutex_;
+    condition_variable condition_;
+    int code_;
+    double window_;
+    batch* open_;
+    bool running_;
+    size_t batches_;
+    size_t members_;
+    size_t max_members_;
+    group_commit(const group_commit&);
+    group_commit& operator=(const group_commit&);
+  };
+
+  // writes queued chunks on background threads, so that write returns before
+  // the handler is called.
+  class write_behind {
+  public:
+    // writes the chunk, and returns zero or a negative error number.
+    typedef int (*write_type)(operations*, write_coalescer::chunk&);
+    write_behind(size_t, size_t);
+    ~write_behind();
+    bool enabled() const;
+    void start(operations*, write_type);
+    void stop();
+    bool push(write_coalescer::chunk&);
+    int wait(const char*, uint64_t);
+    void wait(const char*, off_t, size_t);
+    void stats(lua_State*);
+  private:
+    typedef std::pair<std::string, uint64_t> key_type;
+    struct item {
+      key_type key;
+      write_coalescer::chunk chunk;
+    };
+    mutex mutex_;
+    condition_variable condition_;
+    size_t max_bytes_;
+    size_t thread_count_;
+    operations* self_;
+    write_type write_;
+    std::vector<thread*> threads_;
+    bool stopping_;
+    uint64_t sequence_;
+    std::map<uint64_t, item> items_;
+    std::deque<uint64_t> queue_;
+    // the paths being written.
+    std::set<std::string> running_;
+    std::map<key_type, size_t> pending_;
+    std::map<key_type, int> errors_;
+    size_t bytes_;
+    size_t pushed_;
+    size_t written_;
+    size_t errors_count_;
+    size_t backpressure_waits_;
+    size_t barrier_waits_;
+    static void* start_worker(void*);
+    void work();
+    bool overlaps(const std::string&, off_t, size_t) const;
+    write_behind(const write_behind&);
+    write_behind& operator=(const write_behind&);
+  };
+
+  // tracks the reads of each open file and, once they are sequential, reads
+  // the blocks ahead of them into the block cache on background threads.
+  class readahead_queue {
+  public:
+    enum {
+      fetch_cached = 0,
+      fetch_full = 1,
+      fetch_short = 2
+    };
+    // reads the block into the block cache, and returns one of the codes
+    // above or a negative error number.
+    typedef int (*fetch_type)(operations*, const char*, uint64_t, struct fuse_file_info*);
+    readahead_queue(size_t, size_t);
+    ~readahead_queue();
+    bool enabled() const;
+    void start(operations*, fetch_type);
+    void stop();
+    void access(const char*, const struct fuse_file_info*, uint64_t, size_t, size_t);
+    void close(const char*, uint64_t);
+    void stats(lua_State*);
+  private:
+    typedef std::pair<std::string, uint64_t> key_type;
+    struct stream {
+      // the offset where the next sequential read starts.
+      uint64_t next;
+      size_t run;
+      size_t window;
+      // blocks before this index have been requested.
+      uint64_t issued;
+      // the index after the last block of the file, or zero if unknown.
+      uint64_t end;
+      uint64_t tick;
+      // prefetched blocks which have not been read yet.
+      std::set<uint64_t> pending;
+    };
+    struct request {
+      key_type key;
+      struct fuse_file_info info;
+      uint64_t index;
+      // the context of the read which issued the request.
+      bool has_context;
+      struct fuse_context context;
+    };
+    mutex mutex_;
+    condition_variable condition_;
+    size_t max_window_;
+    size_t thread_count_;
+    size_t max_queue_;
+    operations* self_;
+    fetch_type fetch_;
+    std::vector<thread*> threads_;
+    std::map<key_type, stream> streams_;
+    std::deque<request> queue_;
+    // the number of requests of each handle being read.
+    std::map<key_type, size_t> running_;
+    bool stopping_;
+    uint64_t tick_;
+    size_t streams_count_;
+    size_t sequential_;
+    size_t issued_;
+    size_t fetched_;
+    size_t skipped_;
+    size_t failed_;
+    size_t dropped_;
+    size_t used_;
+    size_t wasted_;
+    static void* start_worker(void*);
+    void work();
+    void erase_oldest();
+    readahead_queue(const readahead_queue&);
+    readahead_queue& operator=(const readahead_queue&);
+  };
+
+  struct options;
+
+  // attributes returned by getattr and fgetattr, and paths which were not
+  // found, shared by all states.  the least recently used entry is evicted
+  // when either map is full.
+  class attr_cache {
+  public:
+    explicit attr_cache(const struct options&);
+    uint64_t generation();
+    bool get(const char*, struct stat*, int*);
+    void put(const char*, const struct stat&, double, uint64_t);
+    void put_negative(const char*, uint64_t);
+    void invalidate(const char*, bool);
+    void invalidate();
+    void stats(lua_State*);
+  private:
+    struct entry {
+      struct stat attr;
+      double expires;
+      std::list<std::string>::iterator position;
+    };
+    struct negative_entry {
+      double expires;
+      std::list<std::string>::iterator position;
+    };
+    mutex mutex_;
+    size_t max_size_;
+    double negative_timeout_;
+    size_t max_negative_size_;
+    std::map<std::string, entry> map_;
+    std::list<std::string> lru_;
+    std::map<std::string, negative_entry> negative_map_;
+    std::list<std::string> negative_lru_;
+    path_generations generations_;
+    size_t hits_;
+    size_t misses_;
+    size_t negative_hits_;
+    size_t negative_misses_;
+    size_t invalidations_;
+    size_t evictions_;
+    attr_cache(const attr_cache&);
+    attr_cache& operator=(const attr_cache&);
+  };
+
+  // options given to fuse.main in addition to the fuse_operations flags.
+  struct options {
+    // pass userdata views of struct stat, struct statvfs and struct
+    // fuse_file_info to handlers instead of fresh tables.
+    unsigned int use_views;
+    // pass a writable buffer to read handlers instead of the size.
+    unsigned int use_read_buffer;
+    // pass a read-only buffer to write handlers instead of a string.
+    unsigned int use_write_buffer;
+    // cache attributes for this many seconds unless the handler returns
+    // another timeout as the second value; zero disables the cache.
+    double attr_timeout;
+    // the maximum number of cached attributes; zero means no limit.
+    size_t attr_cache_size;
+    // cache ENOENT results of getattr for this many seconds.
+    double negative_timeout;
+    // the maximum number of cached ENOENT results; zero means no limit.
+    size_t negative_cache_size;
+    // cache the values of getxattr and listxattr for this many seconds.
+    double xattr_timeout;
+    // the budget of the cached values in bytes; zero means no limit.
+    size_t xattr_cache_size;
+    // memoize statfs, readlink and access for this many seconds unless the
+    // handler returns another timeout as the second value.
+    double memo_timeout;
+    // the maximum number of memoized results; zero means no limit.
+    size_t memo_cache_size;
+    // cache the blocks returned by read in this many bytes; zero disables
+    // the cache.
+    size_t block_cache_size;
+    // the size of the blocks; zero means 64 KiB.
+    size_t block_size;
+    // keep the blocks returned by read in chunk files in this directory;
+    // empty disables the cache.
+    std::string disk_cache_dir;
+    // the maximum number of bytes of the chunk files.
+    size_t disk_cache_size;
+    // read up to this many blocks ahead of sequential reads into the block
+    // cache; zero disables readahead.
+    size_t readahead_blocks;
+    // the number of background threads for readahead; zero means one.
+    size_t readahead_threads;
+    // coalesce concurrent identical getattr, readlink, getxattr and aligned
+    // read requests.
+    unsigned int coalesce;
+    // gather contiguous writes to each handle up to this many bytes before
+    // calling the handler; zero disables the buffer.
+    size_t write_coalesce_size;
+    // write a buffer older than this many seconds on the next write to its
+    // handle; zero means no limit.
+    double write_coalesce_age;
+    // return from write before the handler is called, and queue up to this
+    // many bytes for background threads; zero disables write-behind.
+    size_t write_behind_size;
+    // the number of background threads for write-behind; zero means one.
+    size_t write_behind_threads;
+    // batch concurrent fsync and fsyncdir calls into one call to the
+    // handler, which receives a list of paths and a list of file infos.
+    unsigned int group_commit;
+    // keep a batch open for this many seconds; zero means only while the
+    // previous batch is running.
+    double group_commit_window;
   };
 
   class operations {
   public:
-    operations(state_manager*);
+    operations(state_manager* const*, const struct options&);
     fuse_operations* get();
-    state_manager* manager() const;
+    state_manager* manager(dispatch::code) const;
+    state_manager* manager(operation_class::code) const;
+    const struct options& options() const;
+    attr_cache* attrs();
+    xattr_cache* xattrs();
+    memo_cache* memos();
+    block_cache* blocks();
+    disk_cache* disk();
+    readahead_queue* readahead();
+    singleflight* flights();
+    write_coalescer* writes();
+    write_behind* behind();
+    group_commit* commits(dispatch::code);
   private:
     fuse_operations ops_;
-    state_manager* manager_;
+    state_manager* managers_[operation_class::size];
+    struct options options_;
+    attr_cache attrs_;
+    xattr_cache xattrs_;
+    memo_cache memos_;
+    block_cache blocks_;
+    disk_cache disk_;
+    readahead_queue readahead_;
+    singleflight flights_;
+    write_coalescer writes_;
+    write_behind behind_;
+    group_commit fsyncs_;
+    group_commit fsyncdirs_;
+    void resolve(lua_State*, state_manager*);
     operations(const operations&);
     operations& operator=(const operations&);
   };
@@ -119,8 +771,29 @@ namespace dromozoa {
     scoped_handle& operator=(const scoped_handle&);
   };
 
+  handle* new_buffer(lua_State*, char*, size_t);
+  handle* new_buffer(lua_State*, const char*, size_t);
   handle* new_fill_dir(lua_State*, fuse_fill_dir_t, void*);
 
+  class view : public handle {
+  public:
+    virtual ~view() = 0;
+    virtual bool dirty() const = 0;
+  };
+
+  view* new_view(lua_State*, struct stat*);
+  view* new_view(lua_State*, struct statvfs*);
+  view* new_view(lua_State*, struct fuse_file_info*);
+
+  uint32_t crc32(uint32_t, const char*, size_t);
+
+  // the monotonic time in seconds, and the conversion of a deadline for
+  // timed waits.
+  double now();
+  struct timespec to_timespec(double);
+  // true if path is below prefix, not counting prefix itself.
+  bool is_descendant(const std::string&, const std::string&);
+
   int convert(lua_State*, const struct fuse_context*);
   int convert(lua_State*, const struct fuse_conn_info*);
   int convert(lua_State*, const struct fuse_file_info*);
@@ -130,8 +803,10 @@ namespace dromozoa {
   bool convert(lua_State*, int, struct fuse_conn_info*);
   bool convert(lua_State*, int, struct fuse_file_info*);
   bool convert(lua_State*, int, struct flock*);
+  bool convert(lua_State*, int, struct timespec*);
   bool convert(lua_State*, int, struct stat*);
   bool convert(lua_State*, int, struct statvfs*);
+  bool convert(lua_State*, int, struct options*);
 }
 
 #endif
@@ -0,0 +1,61 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <pthread.h>
+
+namespace dromozoa {
+  namespace {
+    pthread_key_t key;
+    pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    void make_key() {
+      pthread_key_create(&key, 0);
+    }
+  }
+
+  scoped_context::scoped_context(const struct fuse_context* context)
+    : context_(context),
+      saved_() {
+    pthread_once(&once, make_key);
+    saved_ = pthread_getspecific(key);
+    pthread_setspecific(key, this);
+  }
+
+  scoped_context::~scoped_context() {
+    pthread_setspecific(key, saved_);
+  }
+
+  const struct fuse_context* scoped_context::get() const {
+    return context_;
+  }
+
+  // fuse_get_context never returns null; a thread which libfuse does not
+  // run gets a zeroed context, which is taken as none.
+  const struct fuse_context* get_context() {
+    pthread_once(&once, make_key);
+    if (const scoped_context* context = static_cast<const scoped_context*>(pthread_getspecific(key))) {
+      return context->get();
+    }
+    struct fuse_context* context = fuse_get_context();
+    if (!context || !context->private_data) {
+      return 0;
+    }
+    return context;
+  }
+}
@@ -1,4 +1,4 @@
-// Copyright (C) 2018,2019 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2018,2019,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -30,27 +30,21 @@
   that->name = luaX_opt_integer_field(L, index, #name, that->name) \
   /**/
 
+#define DROMOZOA_OPT_NUMBER_FIELD(name) \
+  that->name = opt_number_field(L, index, #name, that->name) \
+  /**/
+
+#define DROMOZOA_OPT_STRING_FIELD(name) \
+  that->name = opt_string_field(L, index, #name, that->name) \
+  /**/
+
 namespace dromozoa {
   namespace {
     bool convert_timespec(lua_State* L, int index, const char* key, struct timespec& tv) {
-      int type = luaX_get_field(L, index, key);
-      if (type == LUA_TNUMBER) {
-        double t = lua_tonumber(L, -1);
-        double i = 0;
-        double f = modf(t, &i);
-        tv.tv_sec = i;
-        tv.tv_nsec = f * 1000000000;
-        lua_pop(L, 1);
-        return true;
-      } else if (type == LUA_TTABLE) {
-        tv.tv_sec = luaX_opt_integer_field<time_t>(L, -1, "tv_sec", 0);
-        tv.tv_nsec = luaX_opt_integer_field<long>(L, -1, "tv_nsec", 0, 0L, 999999999L);
-        lua_pop(L, 1);
-        return true;
-      } else {
-        lua_pop(L, 1);
-        return false;
-      }
+      luaX_get_field(L, index, key);
+      bool result = convert(L, -1, &tv);
+      lua_pop(L, 1);
+      return result;
     }
 
     struct timespec convert_timespec(lua_State* L, int index, const char* key1, const char* key2, const char* key3) {
@@ -65,6 +59,32 @@ namespace dromozoa {
         return tv;
       }
     }
+
+    double opt_number_field(lua_State* L, int index, const char* key, double d) {
+      luaX_get_field(L, index, key);
+      double result = d;
+      if (lua_isnumber(L, -1)) {
+        result = lua_tonumber(L, -1);
+      } else if (!lua_isnil(L, -1)) {
+        luaX_field_error(L, key, "not a number");
+      }
+      lua_pop(L, 1);
+      return result;
+    }
+
+    std::string opt_string_field(lua_State* L, int index, const char* key, const std::string& d) {
+      luaX_get_field(L, index, key);
+      std::string result = d;
+      if (lua_isstring(L, -1)) {
+        size_t size = 0;
+        const char* data = lua_tolstring(L, -1, &size);
+        result.assign(data, size);
+      } else if (!lua_isnil(L, -1)) {
+        luaX_field_error(L, key, "not a string");
+      }
+      lua_pop(L, 1);
+      return result;
+    }
   }
 
   // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L593
@@ -224,6 +244,25 @@ namespace dromozoa {
     }
   }
 
+  // http://pubs.opengroup.org/onlinepubs/9699919799/basedefs/time.h.html
+  bool convert(lua_State* L, int index, struct timespec* that) {
+    int type = lua_type(L, index);
+    if (type == LUA_TNUMBER) {
+      double t = lua_tonumber(L, index);
+      double i = 0;
+      double f = modf(t, &i);
+      that->tv_sec = i;
+      that->tv_nsec = f * 1000000000;
+      return true;
+    } else if (type == LUA_TTABLE) {
+      that->tv_sec = luaX_opt_integer_field<time_t>(L, index, "tv_sec", 0);
+      that->tv_nsec = luaX_opt_integer_field<long>(L, index, "tv_nsec", 0, 0L, 999999999L);
+      return true;
+    } else {
+      return false;
+    }
+  }
+
   // https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/sys_stat.h.html
   // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/stat.2.html
   // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L89
@@ -292,4 +331,36 @@ namespace dromozoa {
       return false;
     }
   }
+
+  bool convert(lua_State* L, int index, struct options* that) {
+    if (lua_istable(L, index)) {
+      DROMOZOA_OPT_FIELD(use_views);
+      DROMOZOA_OPT_FIELD(use_read_buffer);
+      DROMOZOA_OPT_FIELD(use_write_buffer);
+      DROMOZOA_OPT_NUMBER_FIELD(attr_timeout);
+      DROMOZOA_OPT_FIELD(attr_cache_size);
+      DROMOZOA_OPT_NUMBER_FIELD(negative_timeout);
+      DROMOZOA_OPT_FIELD(negative_cache_size);
+      DROMOZOA_OPT_NUMBER_FIELD(xattr_timeout);
+      DROMOZOA_OPT_FIELD(xattr_cache_size);
+      DROMOZOA_OPT_NUMBER_FIELD(memo_timeout);
+      DROMOZOA_OPT_FIELD(memo_cache_size);
+      DROMOZOA_OPT_FIELD(block_cache_size);
+      DROMOZOA_OPT_FIELD(block_size);
+      DROMOZOA_OPT_STRING_FIELD(disk_cache_dir);
+      DROMOZOA_OPT_FIELD(disk_cache_size);
+      DROMOZOA_OPT_FIELD(readahead_blocks);
+      DROMOZOA_OPT_FIELD(readahead_threads);
+      DROMOZOA_OPT_FIELD(coalesce);
+      DROMOZOA_OPT_FIELD(write_coalesce_size);
+      DROMOZOA_OPT_NUMBER_FIELD(write_coalesce_age);
+      DROMOZOA_OPT_FIELD(write_behind_size);
+      DROMOZOA_OPT_FIELD(write_behind_threads);
+      DROMOZOA_OPT_FIELD(group_commit);
+      DROMOZOA_OPT_NUMBER_FIELD(group_commit_window);
+      return true;
+    } else {
+      return false;
+    }
+  }
 }
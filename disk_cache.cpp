@@ -0,0 +1,445 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace dromozoa {
+  namespace {
+    // a chunk file is the header, the path, the token and the data.  the
+    // header is in the byte order of the host, since the cache is local.
+    const char magic[] = { 'D', 'F', 'C', '1' };
+
+    // the maximum number of validation tokens kept in memory.
+    const size_t max_tokens = 65536;
+
+    struct header {
+      char magic[4];
+      uint32_t checksum;
+      uint32_t data_size;
+      uint32_t path_size;
+      uint32_t token_size;
+      uint32_t reserved;
+      uint64_t index;
+    };
+
+    // FNV-1a
+    uint64_t hash(const std::string& path) {
+      uint64_t result = 0xcbf29ce484222325ULL;
+      for (std::string::const_iterator i = path.begin(); i != path.end(); ++i) {
+        result ^= static_cast<unsigned char>(*i);
+        result *= 0x100000001b3ULL;
+      }
+      return result;
+    }
+
+    bool read_all(int fd, char* data, size_t size) {
+      while (size > 0) {
+        ssize_t result = ::read(fd, data, size);
+        if (result > 0) {
+          data += result;
+          size -= result;
+        } else if (result == -1 && errno == EINTR) {
+          continue;
+        } else {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool write_all(int fd, const char* data, size_t size) {
+      while (size > 0) {
+        ssize_t result = ::write(fd, data, size);
+        if (result > 0) {
+          data += result;
+          size -= result;
+        } else if (result == -1 && errno == EINTR) {
+          continue;
+        } else {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // reads the chunk file into the header, the path, the token and the data
+    // unless the file is truncated or not a chunk file.  without data, only
+    // the header, the path and the token are read.
+    bool read_chunk(const std::string& filename, header* head, std::string* path, std::string* token, std::string* data, struct stat* st) {
+      int fd = open(filename.c_str(), O_RDONLY);
+      if (fd == -1) {
+        return false;
+      }
+      bool result = false;
+      if (read_all(fd, reinterpret_cast<char*>(head), sizeof(*head))
+          && memcmp(head->magic, magic, sizeof(magic)) == 0
+          && fstat(fd, st) == 0
+          && static_cast<uint64_t>(st->st_size) == sizeof(*head) + static_cast<uint64_t>(head->path_size) + head->token_size + head->data_size) {
+        size_t size = head->path_size + head->token_size;
+        if (data) {
+          size += head->data_size;
+        }
+        std::vector<char> buffer(size + 1);
+        if (read_all(fd, &buffer[0], size)) {
+          const char* p = &buffer[0];
+          path->assign(p, head->path_size);
+          p += head->path_size;
+          token->assign(p, head->token_size);
+          p += head->token_size;
+          if (data) {
+            data->assign(p, head->data_size);
+          }
+          result = true;
+        }
+      }
+      close(fd);
+      return result;
+    }
+  }
+
+  // chunks are found by an index in memory, which is rebuilt from the
+  // headers of the chunk files when the cache is opened.  the files are
+  // evicted in the order of their modification times across mounts.
+  disk_cache::disk_cache(const std::string& dir, size_t max_bytes)
+    : dir_(dir),
+      max_bytes_(max_bytes),
+      bytes_(),
+      generations_(),
+      sequence_(),
+      hits_(),
+      misses_(),
+      stale_(),
+      corruptions_(),
+      writes_(),
+      write_errors_(),
+      evictions_(),
+      invalidations_() {
+    if (dir_.empty()) {
+      return;
+    }
+    if (mkdir(dir_.c_str(), 0700) == -1 && errno != EEXIST) {
+      throw system_error(errno);
+    }
+    DIR* dir_ptr = opendir(dir_.c_str());
+    if (!dir_ptr) {
+      throw system_error(errno);
+    }
+    std::vector<std::pair<time_t, key_type> > chunks;
+    while (struct dirent* ent = readdir(dir_ptr)) {
+      std::string name = ent->d_name;
+      if (name == "." || name == "..") {
+        continue;
+      }
+      std::string filename = dir_ + "/" + name;
+      if (name[0] == '.') {
+        unlink(filename.c_str());
+        continue;
+      }
+      header head = {};
+      std::string path;
+      std::string token;
+      struct stat st = {};
+      if (read_chunk(filename, &head, &path, &token, 0, &st)
+          && make_filename(path, head.index) == filename) {
+        key_type key(path, head.index);
+        entry& that = map_[key];
+        that.filename = filename;
+        files_[filename] = key;
+        that.size = st.st_size;
+        that.data_size = head.data_size;
+        bytes_ += that.size;
+        chunks.push_back(std::make_pair(st.st_mtime, key));
+      } else {
+        unlink(filename.c_str());
+      }
+    }
+    closedir(dir_ptr);
+    std::sort(chunks.begin(), chunks.end());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      lru_.push_front(chunks[i].second);
+      map_[chunks[i].second].position = lru_.begin();
+    }
+    lock_guard<> lock(mutex_);
+    reclaim();
+  }
+
+  bool disk_cache::enabled() const {
+    return !dir_.empty();
+  }
+
+  uint64_t disk_cache::generation() {
+    lock_guard<> lock(mutex_);
+    return generations_.get();
+  }
+
+  // sets the validation token of the path, and returns true if it replaced
+  // another one.  the least recently validated token is forgotten when there
+  // are too many, and its chunks are not used until the path is opened
+  // again.
+  bool disk_cache::validate(const std::string& path, const std::string& token) {
+    lock_guard<> lock(mutex_);
+    std::map<std::string, token_entry>::iterator i = tokens_.find(path);
+    if (i == tokens_.end()) {
+      if (tokens_.size() >= max_tokens) {
+        tokens_.erase(token_lru_.back());
+        token_lru_.pop_back();
+      }
+      token_lru_.push_front(path);
+      token_entry& that = tokens_[path];
+      that.token = token;
+      that.position = token_lru_.begin();
+      return false;
+    }
+    token_lru_.splice(token_lru_.begin(), token_lru_, i->second.position);
+    if (i->second.token != token) {
+      i->second.token = token;
+      generations_.invalidate(path, false);
+      return true;
+    }
+    return false;
+  }
+
+  // a chunk is valid if its path and token match and its checksum is right.
+  // chunks of a path without a token are never used.
+  bool disk_cache::get(const std::string& path, uint64_t index, std::string* data) {
+    key_type key(path, index);
+    std::string filename;
+    std::string token;
+    {
+      lock_guard<> lock(mutex_);
+      std::map<std::string, token_entry>::const_iterator t = tokens_.find(path);
+      std::map<key_type, entry>::iterator i = map_.find(key);
+      if (t == tokens_.end() || i == map_.end()) {
+        ++misses_;
+        return false;
+      }
+      token = t->second.token;
+      filename = i->second.filename;
+    }
+
+    header head = {};
+    std::string chunk_path;
+    std::string chunk_token;
+    struct stat st = {};
+    bool valid = read_chunk(filename, &head, &chunk_path, &chunk_token, data, &st);
+    bool corrupted = valid && crc32(0, data->data(), data->size()) != head.checksum;
+    bool stale = valid && !corrupted && (chunk_path != path || chunk_token != token || head.index != index);
+
+    lock_guard<> lock(mutex_);
+    if (valid && !corrupted && !stale) {
+      std::map<key_type, entry>::iterator i = map_.find(key);
+      if (i != map_.end()) {
+        lru_.splice(lru_.begin(), lru_, i->second.position);
+      }
+      ++hits_;
+      return true;
+    }
+    if (corrupted) {
+      ++corruptions_;
+    } else if (stale) {
+      ++stale_;
+    }
+    ++misses_;
+    // the file belongs to the key, since put replaces the owner of a file
+    // name shared by another path.
+    std::map<key_type, entry>::iterator i = map_.find(key);
+    if (i != map_.end() && i->second.filename == filename) {
+      erase(i, true);
+    }
+    return false;
+  }
+
+  // the chunk is written to a temporary file and renamed, so that a crash
+  // never leaves a partial chunk.
+  void disk_cache::put(const std::string& path, uint64_t index, const std::string& data, uint64_t generation) {
+    std::string token;
+    std::string tmp;
+    {
+      lock_guard<> lock(mutex_);
+      std::map<std::string, token_entry>::const_iterator t = tokens_.find(path);
+      if (!generations_.valid(path, generation) || t == tokens_.end()) {
+        return;
+      }
+      token = t->second.token;
+      std::ostringstream out;
+      out << dir_ << "/.tmp-" << getpid() << "-" << ++sequence_;
+      tmp = out.str();
+    }
+
+    header head = {};
+    memcpy(head.magic, magic, sizeof(magic));
+    head.checksum = crc32(0, data.data(), data.size());
+    head.data_size = data.size();
+    head.path_size = path.size();
+    head.token_size = token.size();
+    head.index = index;
+
+    bool written = false;
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd != -1) {
+      written = write_all(fd, reinterpret_cast<const char*>(&head), sizeof(head))
+          && write_all(fd, path.data(), path.size())
+          && write_all(fd, token.data(), token.size())
+          && write_all(fd, data.data(), data.size());
+      if (close(fd) == -1) {
+        written = false;
+      }
+    }
+
+    key_type key(path, index);
+    std::string filename = make_filename(path, index);
+    lock_guard<> lock(mutex_);
+    if (!written) {
+      ++write_errors_;
+      unlink(tmp.c_str());
+      return;
+    }
+    if (!generations_.valid(path, generation)) {
+      unlink(tmp.c_str());
+      return;
+    }
+    // the file may hold the chunk of another path with the same hash, which
+    // is replaced and must not be counted twice.
+    std::map<key_type, entry>::iterator i = map_.find(key);
+    if (i != map_.end()) {
+      erase(i, false);
+    }
+    std::map<std::string, key_type>::iterator f = files_.find(filename);
+    if (f != files_.end()) {
+      erase(map_.find(f->second), false);
+    }
+    if (rename(tmp.c_str(), filename.c_str()) == -1) {
+      ++write_errors_;
+      unlink(tmp.c_str());
+      return;
+    }
+    entry& that = map_[key];
+    that.filename = filename;
+    files_[filename] = key;
+    that.size = sizeof(head) + path.size() + token.size() + data.size();
+    that.data_size = data.size();
+    lru_.push_front(key);
+    that.position = lru_.begin();
+    bytes_ += that.size;
+    ++writes_;
+    reclaim();
+  }
+
+  // removes the chunks of the path in the range.  the last chunk before the
+  // range is removed too if it is short, because it marks the end of the
+  // file that the write may extend.
+  void disk_cache::invalidate(const std::string& path, uint64_t offset, uint64_t size, size_t block_size) {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate(path, false);
+    ++invalidations_;
+    if (size == 0) {
+      return;
+    }
+    uint64_t first = offset / block_size;
+    uint64_t last = (offset + size - 1) / block_size;
+    std::map<key_type, entry>::iterator i = map_.lower_bound(key_type(path, first));
+    if (i != map_.begin()) {
+      std::map<key_type, entry>::iterator j = i;
+      --j;
+      if (j->first.first == path && j->second.data_size < block_size) {
+        erase(j, true);
+      }
+    }
+    while (i != map_.end() && i->first.first == path && i->first.second <= last) {
+      erase(i++, true);
+    }
+  }
+
+  // removes the chunks of the path, and of its descendants if requested.
+  void disk_cache::invalidate(const std::string& path, bool descendants) {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate(path, descendants);
+    ++invalidations_;
+    std::map<key_type, entry>::iterator i = map_.lower_bound(key_type(path, 0));
+    while (i != map_.end() && i->first.first.compare(0, path.size(), path) == 0) {
+      if (i->first.first == path || (descendants && is_descendant(i->first.first, path))) {
+        erase(i++, true);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  void disk_cache::invalidate() {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate();
+    ++invalidations_;
+    while (!map_.empty()) {
+      erase(map_.begin(), true);
+    }
+  }
+
+  void disk_cache::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "chunks", map_.size());
+    luaX_set_field(L, -1, "bytes", bytes_);
+    luaX_set_field(L, -1, "tokens", tokens_.size());
+    luaX_set_field(L, -1, "hits", hits_);
+    luaX_set_field(L, -1, "misses", misses_);
+    luaX_set_field(L, -1, "stale", stale_);
+    luaX_set_field(L, -1, "corruptions", corruptions_);
+    luaX_set_field(L, -1, "writes", writes_);
+    luaX_set_field(L, -1, "write_errors", write_errors_);
+    luaX_set_field(L, -1, "evictions", evictions_);
+    luaX_set_field(L, -1, "invalidations", invalidations_);
+  }
+
+  std::string disk_cache::make_filename(const std::string& path, uint64_t index) const {
+    char name[64] = {};
+    snprintf(name, sizeof(name), "%016llx-%llx", static_cast<unsigned long long>(hash(path)), static_cast<unsigned long long>(index));
+    return dir_ + "/" + name;
+  }
+
+  // called with mutex_ locked.
+  void disk_cache::erase(std::map<key_type, entry>::iterator i, bool remove) {
+    if (remove) {
+      unlink(i->second.filename.c_str());
+    }
+    files_.erase(i->second.filename);
+    bytes_ -= i->second.size;
+    lru_.erase(i->second.position);
+    map_.erase(i);
+  }
+
+  // called with mutex_ locked.
+  void disk_cache::reclaim() {
+    while (bytes_ > max_bytes_ && !lru_.empty()) {
+      erase(map_.find(lru_.back()), true);
+      ++evictions_;
+    }
+  }
+}
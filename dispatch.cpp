@@ -0,0 +1,193 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+namespace dromozoa {
+  namespace {
+    // indexed by dispatch::code
+    const char* const names[] = {
+      0,
+      "getattr",
+      "readlink",
+      "mknod",
+      "mkdir",
+      "unlink",
+      "rmdir",
+      "symlink",
+      "rename",
+      "link",
+      "chmod",
+      "chown",
+      "truncate",
+      "open",
+      "read",
+      "write",
+      "statfs",
+      "flush",
+      "release",
+      "fsync",
+      "setxattr",
+      "getxattr",
+      "listxattr",
+      "removexattr",
+      "opendir",
+      "readdir",
+      "releasedir",
+      "fsyncdir",
+      "init",
+      "destroy",
+      "access",
+      "create",
+      "ftruncate",
+      "fgetattr",
+      "lock",
+      "utimens",
+      "flock",
+      "fallocate",
+      "read_buf",
+      "write_buf",
+    };
+
+    // indexed by dispatch::code.  operations which receive a handle are in
+    // the class of the operation which opened it, so that a routing manager
+    // finds the state which knows the handle.
+    const operation_class::code classes[] = {
+      operation_class::lifecycle,
+      operation_class::metadata, // getattr
+      operation_class::metadata, // readlink
+      operation_class::metadata, // mknod
+      operation_class::metadata, // mkdir
+      operation_class::metadata, // unlink
+      operation_class::metadata, // rmdir
+      operation_class::metadata, // symlink
+      operation_class::metadata, // rename
+      operation_class::metadata, // link
+      operation_class::metadata, // chmod
+      operation_class::metadata, // chown
+      operation_class::metadata, // truncate
+      operation_class::data, // open
+      operation_class::data, // read
+      operation_class::data, // write
+      operation_class::metadata, // statfs
+      operation_class::data, // flush
+      operation_class::data, // release
+      operation_class::data, // fsync
+      operation_class::xattr, // setxattr
+      operation_class::xattr, // getxattr
+      operation_class::xattr, // listxattr
+      operation_class::xattr, // removexattr
+      operation_class::directory, // opendir
+      operation_class::directory, // readdir
+      operation_class::directory, // releasedir
+      operation_class::directory, // fsyncdir
+      operation_class::lifecycle, // init
+      operation_class::lifecycle, // destroy
+      operation_class::metadata, // access
+      operation_class::data, // create
+      operation_class::data, // ftruncate
+      operation_class::data, // fgetattr
+      operation_class::data, // lock
+      operation_class::metadata, // utimens
+      operation_class::data, // flock
+      operation_class::data, // fallocate
+      operation_class::data, // read_buf
+      operation_class::data, // write_buf
+    };
+
+    // indexed by operation_class::code
+    const char* const class_names[] = {
+      "metadata",
+      "data",
+      "directory",
+      "xattr",
+      "lifecycle",
+    };
+
+    char registry_key;
+
+    // dispatch tables are kept in a weak table keyed by the thread which owns
+    // them, so that several managers may share one registry.
+    void get_dispatch_tables(lua_State* L) {
+      lua_pushlightuserdata(L, &registry_key);
+      lua_rawget(L, LUA_REGISTRYINDEX);
+      if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_newtable(L);
+        luaX_set_field(L, -1, "__mode", "k");
+        lua_setmetatable(L, -2);
+        lua_pushlightuserdata(L, &registry_key);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+      }
+    }
+
+    // the dispatch table holds the operations table at [0] and the resolved
+    // handlers at [1] .. [dispatch::size - 1].
+    void resolve(lua_State* L, int index, int operations_index) {
+      index = luaX_abs_index(L, index);
+      operations_index = luaX_abs_index(L, operations_index);
+      lua_pushvalue(L, operations_index);
+      lua_rawseti(L, index, 0);
+      for (int i = 1; i < dispatch::size; ++i) {
+        luaX_get_field(L, operations_index, names[i]);
+        lua_rawseti(L, index, i);
+      }
+    }
+
+    void impl_refresh(lua_State* L) {
+      get_dispatch_tables(L);
+      lua_pushthread(L);
+      lua_rawget(L, -2);
+      if (!lua_istable(L, -1)) {
+        luaX_throw_failure("dispatch table not found");
+      }
+      int index = lua_gettop(L);
+      if (lua_isnoneornil(L, 1)) {
+        lua_rawgeti(L, index, 0);
+      } else {
+        lua_pushvalue(L, 1);
+      }
+      resolve(L, index, -1);
+      luaX_push(L, true);
+    }
+  }
+
+  void new_dispatch(lua_State* L, int index) {
+    index = luaX_abs_index(L, index);
+    lua_createtable(L, dispatch::size, 0);
+    resolve(L, -1, index);
+    get_dispatch_tables(L);
+    lua_pushthread(L);
+    lua_pushvalue(L, -3);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+  }
+
+  operation_class::code get_operation_class(dispatch::code code) {
+    return classes[code];
+  }
+
+  const char* get_operation_class_name(operation_class::code code) {
+    return class_names[code];
+  }
+
+  void initialize_dispatch(lua_State* L) {
+    luaX_set_field(L, -1, "refresh", impl_refresh);
+  }
+}
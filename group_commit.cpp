@@ -0,0 +1,132 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <errno.h>
+#include <pthread.h>
+
+#include <algorithm>
+
+namespace dromozoa {
+  group_commit::group_commit(int code, double window)
+    : code_(code),
+      window_(window),
+      open_(),
+      running_(),
+      batches_(),
+      members_(),
+      max_members_() {}
+
+  // the first caller leads a batch, which stays open for the window and
+  // while the previous batch is running.  callers arriving meanwhile join
+  // it, and all of them return when the leader has committed it.
+  int group_commit::commit(operations* self, commit_type commit, const char* path, int datasync, const struct fuse_file_info* info) {
+    batch* that = 0;
+    size_t index = 0;
+    bool leader = false;
+    {
+      lock_guard<> lock(mutex_);
+      that = open_;
+      if (!that) {
+        that = new batch();
+        that->done = false;
+        that->waiters = 0;
+        open_ = that;
+        leader = true;
+      }
+      index = that->members.size();
+      that->members.push_back(member());
+      member& m = that->members.back();
+      m.path = path ? path : "";
+      m.has_info = info != 0;
+      if (info) {
+        m.info = *info;
+      }
+      m.datasync = datasync;
+      m.result = -EIO;
+      ++that->waiters;
+    }
+
+    // failures of the waits are returned as errors of the members, since
+    // nothing above a callback would catch an exception.
+    if (leader) {
+      int error = 0;
+      {
+        lock_guard<> lock(mutex_);
+        if (window_ > 0) {
+          double deadline = now() + window_;
+          while (now() < deadline) {
+            struct timespec ts = to_timespec(deadline);
+            int result = pthread_cond_timedwait(condition_.native_handle(), lock.mutex()->native_handle(), &ts);
+            if (result != 0 && result != ETIMEDOUT) {
+              error = result;
+              break;
+            }
+          }
+        }
+        while (!error && running_) {
+          error = pthread_cond_wait(condition_.native_handle(), lock.mutex()->native_handle());
+        }
+        open_ = 0;
+        if (error) {
+          for (size_t i = 0; i < that->members.size(); ++i) {
+            that->members[i].result = -error;
+          }
+          that->done = true;
+          pthread_cond_broadcast(condition_.native_handle());
+        } else {
+          running_ = true;
+          ++batches_;
+          members_ += that->members.size();
+          max_members_ = std::max(max_members_, that->members.size());
+        }
+      }
+      if (!error) {
+        commit(self, code_, that->members);
+        lock_guard<> lock(mutex_);
+        running_ = false;
+        that->done = true;
+        pthread_cond_broadcast(condition_.native_handle());
+      }
+    }
+
+    lock_guard<> lock(mutex_);
+    int result = 0;
+    while (!that->done) {
+      if (int error = pthread_cond_wait(condition_.native_handle(), lock.mutex()->native_handle())) {
+        result = -error;
+        break;
+      }
+    }
+    if (that->done) {
+      result = that->members[index].result;
+    }
+    if (--that->waiters == 0) {
+      delete that;
+    }
+    return result;
+  }
+
+  void group_commit::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "batches", batches_);
+    luaX_set_field(L, -1, "members", members_);
+    luaX_set_field(L, -1, "max_members", max_members_);
+  }
+}
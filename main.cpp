@@ -1,4 +1,4 @@
-// Copyright (C) 2018,2019 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2018,2019,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -17,15 +17,52 @@
 
 #include "common.hpp"
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
 
 namespace dromozoa {
   namespace {
+    // the second argument of fuse.main is a state manager or a table which
+    // maps operation classes to state managers.  classes not in the table are
+    // run by the default manager.
+    void check_state_managers(lua_State* L, int arg, state_manager** managers) {
+      if (!lua_istable(L, arg)) {
+        std::fill(managers, managers + operation_class::size, check_state_manager(L, arg));
+        return;
+      }
+      state_manager* default_manager = 0;
+      luaX_get_field(L, arg, "default");
+      if (!lua_isnil(L, -1)) {
+        default_manager = luaX_to_udata<state_manager>(L, -1, "dromozoa.fuse.state_manager");
+        if (!default_manager) {
+          luaX_field_error(L, "default", "not a state_manager");
+        }
+      }
+      lua_pop(L, 1);
+      for (int i = 0; i < operation_class::size; ++i) {
+        const char* name = get_operation_class_name(static_cast<operation_class::code>(i));
+        luaX_get_field(L, arg, name);
+        if (lua_isnil(L, -1)) {
+          managers[i] = default_manager;
+          if (!managers[i]) {
+            luaX_field_error(L, name, "state_manager expected");
+          }
+        } else {
+          managers[i] = luaX_to_udata<state_manager>(L, -1, "dromozoa.fuse.state_manager");
+          if (!managers[i]) {
+            luaX_field_error(L, name, "not a state_manager");
+          }
+        }
+        lua_pop(L, 1);
+      }
+    }
+
     void impl_main(lua_State* L) {
       luaL_checktype(L, 1, LUA_TTABLE);
-      state_manager* manager = check_state_manager(L, 2);
+      state_manager* managers[operation_class::size] = {};
+      check_state_managers(L, 2, managers);
 
       std::vector<std::string> args;
       for (int i = 1; ; ++i) {
@@ -48,21 +85,104 @@ namespace dromozoa {
       }
       argv.push_back(0);
 
-      scoped_ptr<operations> self(new operations(manager));
+      struct options options = {};
+      convert(L, 3, &options);
+
+      scoped_ptr<operations> self(new operations(managers, options));
       fuse_operations* ops = self->get();
       convert(L, 3, ops);
       int result = fuse_main(argv.size() - 1, const_cast<char**>(argv.data()), ops, self.release());
       luaX_push(L, result);
     }
 
+    // handlers run on the threads of the readahead queue see the context of
+    // the read which issued the prefetch.  nil is returned on a thread which
+    // works for no request.
     void impl_get_context(lua_State* L) {
-      convert(L, fuse_get_context());
+      if (const struct fuse_context* context = get_context()) {
+        convert(L, context);
+      } else {
+        lua_pushnil(L);
+      }
+    }
+
+    operations* check_operations() {
+      const struct fuse_context* context = get_context();
+      if (!context || !context->private_data) {
+        luaX_throw_failure("no fuse context");
+      }
+      return static_cast<operations*>(context->private_data);
+    }
+
+    // the counters of the mount are available in handlers.
+    void impl_stats(lua_State* L) {
+      operations* self = check_operations();
+      lua_newtable(L);
+      self->manager(operation_class::lifecycle)->stats(L);
+      luaX_set_field(L, -2, "state_manager");
+      lua_newtable(L);
+      for (int i = 0; i < operation_class::size; ++i) {
+        operation_class::code code = static_cast<operation_class::code>(i);
+        self->manager(code)->stats(L);
+        luaX_set_field(L, -2, get_operation_class_name(code));
+      }
+      luaX_set_field(L, -2, "state_managers");
+      self->attrs()->stats(L);
+      luaX_set_field(L, -2, "attr_cache");
+      self->xattrs()->stats(L);
+      luaX_set_field(L, -2, "xattr_cache");
+      self->memos()->stats(L);
+      luaX_set_field(L, -2, "memo_cache");
+      self->blocks()->stats(L);
+      luaX_set_field(L, -2, "block_cache");
+      self->disk()->stats(L);
+      luaX_set_field(L, -2, "disk_cache");
+      self->readahead()->stats(L);
+      luaX_set_field(L, -2, "readahead");
+      self->flights()->stats(L);
+      luaX_set_field(L, -2, "singleflight");
+      self->writes()->stats(L);
+      luaX_set_field(L, -2, "write_coalescer");
+      self->behind()->stats(L);
+      luaX_set_field(L, -2, "write_behind");
+      lua_newtable(L);
+      self->commits(dispatch::fsync)->stats(L);
+      luaX_set_field(L, -2, "fsync");
+      self->commits(dispatch::fsyncdir)->stats(L);
+      luaX_set_field(L, -2, "fsyncdir");
+      luaX_set_field(L, -2, "group_commit");
+    }
+
+    // fuse.invalidate([path]) drops the cached attributes, extended
+    // attributes, memoized results, blocks and chunk files of the path and
+    // its descendants, or all of them.
+    void impl_invalidate(lua_State* L) {
+      operations* self = check_operations();
+      if (lua_isnoneornil(L, 1)) {
+        self->attrs()->invalidate();
+        self->xattrs()->invalidate();
+        self->memos()->invalidate();
+        self->blocks()->invalidate();
+        self->disk()->invalidate();
+        self->flights()->invalidate();
+      } else {
+        const char* path = luaL_checkstring(L, 1);
+        self->attrs()->invalidate(path, true);
+        self->xattrs()->invalidate(path, true);
+        self->memos()->invalidate(path, true);
+        self->blocks()->invalidate(path, true);
+        self->disk()->invalidate(path, true);
+        self->flights()->invalidate(path, true);
+      }
+      luaX_push(L, true);
     }
   }
 
   void initialize_main(lua_State* L) {
     luaX_set_field(L, -1, "main", impl_main);
     luaX_set_field(L, -1, "get_context", impl_get_context);
+    luaX_set_field(L, -1, "stats", impl_stats);
+    luaX_set_field(L, -1, "invalidate", impl_invalidate);
 
     luaX_set_field(L, -1, "FUSE_CAP_ASYNC_READ", FUSE_CAP_ASYNC_READ);
     luaX_set_field(L, -1, "FUSE_CAP_POSIX_LOCKS", FUSE_CAP_POSIX_LOCKS);
@@ -1,4 +1,4 @@
-// Copyright (C) 2019 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2019,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -17,16 +17,69 @@
 
 #include "common.hpp"
 
+#include <errno.h>
+
+#include <exception>
+
 namespace dromozoa {
   managed_state::managed_state(state_manager* manager)
     : manager_(manager),
-      state_(manager->open()) {}
+      state_(),
+      result_(),
+      attach_(),
+      detach_() {
+    open(0, 0);
+  }
 
+  managed_state::managed_state(state_manager* manager, const char* path, const struct fuse_file_info* info)
+    : manager_(manager),
+      state_(),
+      result_(),
+      attach_(),
+      detach_() {
+    open(path, info);
+  }
+
+  // the handle is attached or detached after the handler has returned and
+  // the file info has been written back.  a released handle is detached even
+  // if no state was available.
   managed_state::~managed_state() {
-    manager_->close(state_);
+    if (detach_) {
+      manager_->detach_handle(detach_->fh);
+    }
+    if (state_) {
+      if (attach_) {
+        manager_->attach_handle(state_, attach_->fh);
+      }
+      manager_->close(state_);
+    }
   }
 
   lua_State* managed_state::get() const {
     return state_;
   }
+
+  int managed_state::result() const {
+    return result_;
+  }
+
+  void managed_state::attach(const struct fuse_file_info* info) {
+    attach_ = info;
+  }
+
+  void managed_state::detach(const struct fuse_file_info* info) {
+    detach_ = info;
+  }
+
+  // a manager may throw system_error when no state is available in time.
+  void managed_state::open(const char* path, const struct fuse_file_info* info) {
+    try {
+      state_ = manager_->open_route(path, info);
+    } catch (const system_error& e) {
+      result_ = -e.code();
+    } catch (const std::exception& e) {
+      DROMOZOA_UNEXPECTED(e.what());
+      result_ = -EIO;
+    }
+  }
 }
@@ -0,0 +1,129 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+namespace dromozoa {
+  memo_cache::memo_cache(size_t max_size)
+    : max_size_(max_size),
+      generations_(),
+      hits_(),
+      misses_(),
+      invalidations_(),
+      evictions_() {}
+
+  // the path comes first and is terminated by NUL, so that the results of a
+  // path are found by its prefix.
+  std::string memo_cache::key(const char* path, int code, const std::string& args) {
+    std::string key(path);
+    key += '\0';
+    key += static_cast<char>(code);
+    key += args;
+    return key;
+  }
+
+  uint64_t memo_cache::generation() {
+    lock_guard<> lock(mutex_);
+    return generations_.get();
+  }
+
+  bool memo_cache::get(const std::string& key, std::string* data, int* result) {
+    lock_guard<> lock(mutex_);
+    std::map<std::string, entry>::iterator i = map_.find(key);
+    if (i != map_.end()) {
+      if (i->second.expires > now()) {
+        lru_.splice(lru_.begin(), lru_, i->second.position);
+        *data = i->second.data;
+        *result = i->second.result;
+        ++hits_;
+        return true;
+      }
+      erase(i);
+    }
+    ++misses_;
+    return false;
+  }
+
+  // the result is dropped if the path was invalidated after the handler
+  // was called.
+  void memo_cache::put(const std::string& key, const std::string& data, int result, double ttl, uint64_t generation) {
+    if (ttl <= 0) {
+      return;
+    }
+    lock_guard<> lock(mutex_);
+    if (!generations_.valid(key.substr(0, key.find('\0')), generation)) {
+      return;
+    }
+    std::map<std::string, entry>::iterator i = map_.find(key);
+    if (i == map_.end()) {
+      if (max_size_ > 0 && map_.size() >= max_size_) {
+        erase(map_.find(lru_.back()));
+        ++evictions_;
+      }
+      lru_.push_front(key);
+      i = map_.insert(std::make_pair(key, entry())).first;
+      i->second.position = lru_.begin();
+    } else {
+      lru_.splice(lru_.begin(), lru_, i->second.position);
+    }
+    entry& that = i->second;
+    that.data = data;
+    that.result = result;
+    that.expires = now() + ttl;
+  }
+
+  // removes the results of the path, and of its descendants if requested.
+  void memo_cache::invalidate(const char* path, bool descendants) {
+    std::string prefix(path);
+    lock_guard<> lock(mutex_);
+    generations_.invalidate(prefix, descendants);
+    ++invalidations_;
+    std::map<std::string, entry>::iterator i = map_.lower_bound(prefix);
+    while (i != map_.end() && i->first.compare(0, prefix.size(), prefix) == 0) {
+      char c = i->first[prefix.size()];
+      if (c == '\0' || (descendants && (c == '/' || prefix == "/"))) {
+        erase(i++);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  void memo_cache::invalidate() {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate();
+    ++invalidations_;
+    map_.clear();
+    lru_.clear();
+  }
+
+  void memo_cache::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "entries", map_.size());
+    luaX_set_field(L, -1, "hits", hits_);
+    luaX_set_field(L, -1, "misses", misses_);
+    luaX_set_field(L, -1, "invalidations", invalidations_);
+    luaX_set_field(L, -1, "evictions", evictions_);
+  }
+
+  // called with mutex_ locked.
+  void memo_cache::erase(std::map<std::string, entry>::iterator i) {
+    lru_.erase(i->second.position);
+    map_.erase(i);
+  }
+}
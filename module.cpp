@@ -1,4 +1,4 @@
-// Copyright (C) 2018,2019 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2018,2019,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -18,14 +18,20 @@
 #include "common.hpp"
 
 namespace dromozoa {
+  void initialize_buffer(lua_State*);
+  void initialize_dispatch(lua_State*);
   void initialize_fill_dir(lua_State*);
   void initialize_main(lua_State*);
   void initialize_state_manager(lua_State*);
+  void initialize_view(lua_State*);
 
   void initialize(lua_State* L) {
+    initialize_buffer(L);
+    initialize_dispatch(L);
     initialize_fill_dir(L);
     initialize_main(L);
     initialize_state_manager(L);
+    initialize_view(L);
   }
 }
 
@@ -1,4 +1,4 @@
-// Copyright (C) 2018,2019,2024 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2018,2019,2024,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -18,13 +18,21 @@
 #include "common.hpp"
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef ENOATTR
+#define ENOATTR ENODATA
+#endif
 
 #define DROMOZOA_SET_OPERATION(name) \
   do { \
-    if (check(L, #name)) { \
+    if (manager(dispatch::name) == target && check(L, dispatch::name)) { \
       ops_.name = name; \
     } \
   } while (false) \
@@ -38,10 +46,22 @@ namespace dromozoa {
       scoped_converter(lua_State* state, T* ptr)
         : state_(state),
           ptr_(ptr),
+          view_(),
           index_(convert(state, ptr)) {}
 
+      // a view writes through to the structure, so no write-back is needed.
+      scoped_converter(lua_State* state, T* ptr, bool use_view)
+        : state_(state),
+          ptr_(ptr),
+          view_(use_view ? new_view(state, ptr) : 0),
+          index_(view_ ? lua_gettop(state) : convert(state, ptr)) {}
+
       ~scoped_converter() {
-        convert(state_, index_, ptr_);
+        if (view_) {
+          view_->reset();
+        } else {
+          convert(state_, index_, ptr_);
+        }
       }
 
       int index() const {
@@ -51,6 +71,7 @@ namespace dromozoa {
     private:
       lua_State* state_;
       T* ptr_;
+      view* view_;
       int index_;
       scoped_converter(const scoped_converter&);
       scoped_converter& operator=(const scoped_converter&);
@@ -60,23 +81,41 @@ namespace dromozoa {
     typedef scoped_converter<struct fuse_file_info> file_info_t;
     typedef scoped_converter<struct flock> flock_t;
 
-    bool prepare(lua_State* L, int index, const char* name) {
-      if (luaX_get_field(L, index, name) != LUA_TNIL) {
-        lua_pushvalue(L, index);
+    // push the handler and the operations table from the dispatch table which
+    // has been resolved once for each state.
+    bool prepare(lua_State* L, int index, int code) {
+      lua_rawgeti(L, index, code);
+      if (!lua_isnil(L, -1)) {
+        lua_rawgeti(L, index, 0);
         return true;
       } else {
         return false;
       }
     }
 
-    bool check(lua_State* L, const char* name) {
-      bool result = luaX_get_field(L, -1, name) != LUA_TNIL;
+    bool check(lua_State* L, int code) {
+      lua_rawgeti(L, -1, code);
+      bool result = !lua_isnil(L, -1);
       lua_pop(L, 1);
       return result;
     }
 
-    int call(lua_State* L, int nargs, int d = 0) {
-      if (lua_pcall(L, nargs, 1, 0) == 0) {
+    // a number returned as the second value is stored in ttl.
+    int call(lua_State* L, int nargs, int d = 0, double* ttl = 0, std::string* token = 0) {
+      if (lua_pcall(L, nargs, ttl || token ? 2 : 1, 0) == 0) {
+        if (ttl) {
+          if (lua_isnumber(L, -1)) {
+            *ttl = lua_tonumber(L, -1);
+          }
+          lua_pop(L, 1);
+        } else if (token) {
+          if (lua_isstring(L, -1)) {
+            size_t size = 0;
+            const char* data = lua_tolstring(L, -1, &size);
+            token->assign(data, size);
+          }
+          lua_pop(L, 1);
+        }
         if (luaX_is_integer(L, -1)) {
           return lua_tointeger(L, -1);
         } else if (lua_isnil(L, -1)) {
@@ -92,45 +131,481 @@ namespace dromozoa {
       return -ENOSYS;
     }
 
+    // a number returned as the second value is stored in ttl.
+    template <class T>
+    int call_struct_impl(lua_State* L, int nargs, T* buffer, const view* view, double* ttl) {
+      if (lua_pcall(L, nargs, ttl ? 2 : 1, 0) == 0) {
+        if (ttl) {
+          if (lua_isnumber(L, -1)) {
+            *ttl = lua_tonumber(L, -1);
+          }
+          lua_pop(L, 1);
+        }
+        if (luaX_is_integer(L, -1)) {
+          return lua_tointeger(L, -1);
+        } else if (convert(L, -1, buffer)) {
+          return 0;
+        } else if (view && view->dirty() && lua_isnil(L, -1)) {
+          return 0;
+        }
+        DROMOZOA_UNEXPECTED("must return a table");
+      } else {
+        if (luaX_is_integer(L, -1)) {
+          return lua_tointeger(L, -1);
+        }
+        DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
+      }
+      return -ENOSYS;
+    }
+
+    // the handler may return a table or fill the view given as the last
+    // argument.
+    template <class T>
+    int call_struct(lua_State* L, int nargs, T* buffer, bool use_view, double* ttl = 0) {
+      if (use_view) {
+        memset(buffer, 0, sizeof(*buffer));
+        view* view = new_view(L, buffer);
+        scoped_handle scope(view);
+        return call_struct_impl(L, nargs + 1, buffer, view, ttl);
+      } else {
+        return call_struct_impl(L, nargs, buffer, 0, ttl);
+      }
+    }
+
+    attr_cache* get_attrs(operations* self) {
+      const struct options& options = self->options();
+      return options.attr_timeout > 0 || options.negative_timeout > 0 ? self->attrs() : 0;
+    }
+
+    xattr_cache* get_xattrs(operations* self) {
+      return self->options().xattr_timeout > 0 ? self->xattrs() : 0;
+    }
+
+    memo_cache* get_memos(operations* self) {
+      return self->options().memo_timeout > 0 ? self->memos() : 0;
+    }
+
+    block_cache* get_blocks(operations* self) {
+      return self->options().block_cache_size > 0 ? self->blocks() : 0;
+    }
+
+    disk_cache* get_disk(operations* self) {
+      return self->disk()->enabled() ? self->disk() : 0;
+    }
+
+    write_coalescer* get_writes(operations* self) {
+      return self->writes()->enabled() ? self->writes() : 0;
+    }
+
+    write_behind* get_behind(operations* self) {
+      return self->behind()->enabled() ? self->behind() : 0;
+    }
+
+    singleflight* get_flights(operations* self) {
+      return self->options().coalesce ? self->flights() : 0;
+    }
+
+    // joins the identical call in flight, or leads a new one and shares its
+    // result when it goes out of scope.
+    class scoped_flight {
+    public:
+      scoped_flight(singleflight* flights, const char* path, dispatch::code code, const std::string& args)
+        : flights_(flights),
+          leader_(),
+          result_(-EIO) {
+        if (flights_) {
+          leader_ = flights_->join(memo_cache::key(path, code, args), &result_, &data_);
+        }
+      }
+
+      ~scoped_flight() {
+        if (leader_) {
+          flights_->done(leader_, result_, data_);
+        }
+      }
+
+      bool follower() const {
+        return flights_ && !leader_;
+      }
+
+      int result() const {
+        return result_;
+      }
+
+      const std::string& data() const {
+        return data_;
+      }
+
+      // copies the shared data to the buffer of a follower.
+      int copy(void* buffer, size_t size) const {
+        if (result_ >= 0) {
+          memcpy(buffer, data_.data(), std::min(size, data_.size()));
+        }
+        return result_;
+      }
+
+      int set(int result, const void* data, size_t size) {
+        if (leader_) {
+          result_ = result;
+          data_.assign(static_cast<const char*>(data), size);
+        }
+        return result;
+      }
+
+    private:
+      singleflight* flights_;
+      singleflight::call* leader_;
+      int result_;
+      std::string data_;
+      scoped_flight(const scoped_flight&);
+      scoped_flight& operator=(const scoped_flight&);
+    };
+
+    std::string flight_args(uint64_t a, uint64_t b = 0) {
+      std::ostringstream out;
+      out << a << ':' << b;
+      return out.str();
+    }
+
+    // results which do not change until the path is modified.
+    bool is_memoizable(int result) {
+      return result == 0 || result == -ENOENT || result == -EACCES || result == -EPERM || result == -EINVAL;
+    }
+
+    // invalidates the cached attributes, extended attributes, memoized
+    // results and blocks of the path after the handler has returned.  a
+    // write invalidates only the blocks in its range.  the attributes of the
+    // parent directory are invalidated when its entries change, and those of
+    // the descendants when a directory is renamed.
+    class scoped_invalidation {
+    public:
+      scoped_invalidation(operations* self, const char* path, bool parent = false, bool descendants = false)
+        : attrs_(get_attrs(self)),
+          xattrs_(get_xattrs(self)),
+          memos_(get_memos(self)),
+          blocks_(get_blocks(self)),
+          disk_(get_disk(self)),
+          flights_(get_flights(self)),
+          block_size_(self->blocks()->block_size()),
+          path_(path),
+          parent_(parent),
+          descendants_(descendants),
+          permissions_(),
+          ranged_(),
+          offset_(),
+          size_() {}
+
+      void range(off_t offset, size_t size) {
+        ranged_ = true;
+        offset_ = offset;
+        size_ = size;
+      }
+
+      // the memoized access results of the descendants depend on the mode
+      // and the owner of the path, so they are invalidated too.
+      void permissions() {
+        permissions_ = true;
+      }
+
+      ~scoped_invalidation() {
+        if (!path_) {
+          return;
+        }
+        if (attrs_) {
+          attrs_->invalidate(path_, descendants_);
+          if (parent_) {
+            std::string path(path_);
+            std::string::size_type i = path.rfind('/');
+            if (i != std::string::npos) {
+              attrs_->invalidate(i == 0 ? "/" : path.substr(0, i).c_str(), false);
+            }
+          }
+        }
+        if (xattrs_) {
+          xattrs_->invalidate(path_, descendants_);
+        }
+        if (memos_) {
+          memos_->invalidate(path_, descendants_ || permissions_);
+        }
+        if (blocks_) {
+          if (ranged_) {
+            blocks_->invalidate(path_, offset_, size_);
+          } else {
+            blocks_->invalidate(path_, descendants_);
+          }
+        }
+        if (disk_) {
+          if (ranged_) {
+            disk_->invalidate(path_, offset_, size_, block_size_);
+          } else {
+            disk_->invalidate(path_, descendants_);
+          }
+        }
+        // requests in flight for the path may have been made before the
+        // change, so later ones do not join them.
+        if (flights_) {
+          flights_->invalidate(path_, descendants_ || permissions_);
+          if (parent_) {
+            std::string path(path_);
+            std::string::size_type i = path.rfind('/');
+            if (i != std::string::npos) {
+              flights_->invalidate(i == 0 ? "/" : path.substr(0, i).c_str(), false);
+            }
+          }
+        }
+      }
+
+    private:
+      attr_cache* attrs_;
+      xattr_cache* xattrs_;
+      memo_cache* memos_;
+      block_cache* blocks_;
+      disk_cache* disk_;
+      singleflight* flights_;
+      size_t block_size_;
+      const char* path_;
+      bool parent_;
+      bool descendants_;
+      bool permissions_;
+      bool ranged_;
+      off_t offset_;
+      size_t size_;
+      scoped_invalidation(const scoped_invalidation&);
+      scoped_invalidation& operator=(const scoped_invalidation&);
+    };
+
+    // every value returned by the handler is cached whatever the size was,
+    // since the cache answers size probes and ERANGE by itself.  of the
+    // errors only ENOATTR is cached, because others such as ERANGE depend on
+    // the size.
+    int call_xattr(lua_State* L, int nargs, char* buffer, size_t size, xattr_cache* xattrs, const char* path, const char* name, uint64_t generation) {
+      if (lua_pcall(L, nargs, 1, 0) == 0) {
+        if (luaX_is_integer(L, -1)) {
+          int result = lua_tointeger(L, -1);
+          if (xattrs && result == -ENOATTR) {
+            xattrs->put(path, name, 0, 0, result, generation);
+          }
+          return result;
+        } else if (luaX_string_reference result = luaX_to_string(L, -1)) {
+          if (xattrs) {
+            xattrs->put(path, name, result.data(), result.size(), 0, generation);
+            if (size == 0) {
+              return result.size();
+            }
+          }
+          if (result.size() > size) {
+            return -ERANGE;
+          }
+          memset(buffer, 0, size);
+          memcpy(buffer, result.data(), result.size());
+          return result.size();
+        }
+        DROMOZOA_UNEXPECTED("must return a string");
+      } else {
+        if (luaX_is_integer(L, -1)) {
+          return lua_tointeger(L, -1);
+        }
+        DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
+      }
+      return -ENOSYS;
+    }
+
+    // caches the attributes for the timeout of the options or the one
+    // returned by the handler, and remembers the paths which were not found.
+    int call_attr(lua_State* L, int nargs, const char* path, struct stat* buffer, operations* self, attr_cache* attrs, uint64_t generation) {
+      if (!attrs) {
+        return call_struct(L, nargs, buffer, self->options().use_views);
+      }
+      double ttl = self->options().attr_timeout;
+      int result = call_struct(L, nargs, buffer, self->options().use_views, &ttl);
+      if (result == 0) {
+        attrs->put(path, *buffer, ttl, generation);
+      } else if (result == -ENOENT) {
+        attrs->put_negative(path, generation);
+      }
+      return result;
+    }
+
+    // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/write.2.html
+    // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L189
+    int write_handler(operations* self, const char* path, const char* buffer, size_t size, off_t offset, struct fuse_file_info* info_ptr) {
+      scoped_invalidation invalidation(self, path);
+      invalidation.range(offset, size);
+      managed_state state(self->manager(dispatch::write), path, info_ptr);
+      lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
+      luaX_top_saver save(L);
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::write)) {
+        if (self->options().use_write_buffer) {
+          // the buffer and its slices are invalidated when the call returns.
+          luaX_push(L, path);
+          scoped_handle scope(new_buffer(L, buffer, size));
+          luaX_push(L, offset);
+          lua_pushvalue(L, info.index());
+          return call(L, 5, size);
+        }
+        luaX_push(L, path, luaX_string_reference(buffer, size), offset);
+        lua_pushvalue(L, info.index());
+        return call(L, 5, size);
+      }
+      return -ENOSYS;
+    }
+
+    // writes the chunk, and returns zero or the error.  a short write is an
+    // error, since the caller was told that all of the bytes were written.
+    int write_chunk(operations* self, write_coalescer::chunk& chunk) {
+      int result = write_handler(self, chunk.path.c_str(), chunk.data.data(), chunk.data.size(), chunk.offset, &chunk.info);
+      if (result >= 0 && static_cast<size_t>(result) != chunk.data.size()) {
+        return -EIO;
+      }
+      return result < 0 ? result : 0;
+    }
+
+    // queues the chunks for write-behind, or writes them, and returns the
+    // first error.
+    int write_chunks(operations* self, std::vector<write_coalescer::chunk>& chunks) {
+      write_behind* behind = get_behind(self);
+      int result = 0;
+      for (size_t i = 0; i < chunks.size(); ++i) {
+        if (behind && behind->push(chunks[i])) {
+          continue;
+        }
+        int n = write_chunk(self, chunks[i]);
+        if (n < 0 && result == 0) {
+          result = n;
+        }
+      }
+      return result;
+    }
+
+    // writes the buffer of the handle and waits for its queued writes.  the
+    // first error of them is returned.
+    int flush_writes(operations* self, const char* path, const struct fuse_file_info* info_ptr) {
+      if (!path || !info_ptr) {
+        return 0;
+      }
+      int result = 0;
+      if (write_coalescer* writes = get_writes(self)) {
+        std::vector<write_coalescer::chunk> chunks;
+        writes->take(path, info_ptr->fh, &chunks);
+        result = write_chunks(self, chunks);
+      }
+      if (write_behind* behind = get_behind(self)) {
+        int deferred = behind->wait(path, info_ptr->fh);
+        if (result == 0) {
+          result = deferred;
+        }
+      }
+      return result;
+    }
+
+    // writes the buffers of the path which overlap the range, or all of them
+    // if size is zero, and waits for the queued writes of the range.  errors
+    // of the queued writes are left to the barriers of their handles.
+    int flush_writes(operations* self, const char* path, off_t offset, size_t size) {
+      if (!path) {
+        return 0;
+      }
+      int result = 0;
+      if (write_coalescer* writes = get_writes(self)) {
+        std::vector<write_coalescer::chunk> chunks;
+        writes->take(path, offset, size, &chunks);
+        result = write_chunks(self, chunks);
+      }
+      if (write_behind* behind = get_behind(self)) {
+        behind->wait(path, offset, size);
+      }
+      return result;
+    }
+
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/stat.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L89
-    int getattr(const char* path, struct stat* buffer) {
+    // buffered and queued writes of the path are written first, as in
+    // truncate, since they may extend the file.
+    int getattr_impl(const char* path, struct stat* buffer) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      if (int result = flush_writes(self, path, 0, 0)) {
+        return result;
+      }
+      attr_cache* attrs = get_attrs(self);
+      int result = 0;
+      if (attrs && attrs->get(path, buffer, &result)) {
+        return result;
+      }
+      uint64_t generation = attrs ? attrs->generation() : 0;
+      managed_state state(self->manager(dispatch::getattr), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "getattr")) {
+      if (prepare(L, save.get(), dispatch::getattr)) {
         luaX_push(L, path);
-        if (lua_pcall(L, 2, 1, 0) == 0) {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          } else if (convert(L, -1, buffer)) {
-            return 0;
-          }
-          DROMOZOA_UNEXPECTED("must return a table");
-        } else {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          }
-          DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
-        }
+        return call_attr(L, 2, path, buffer, self, attrs, generation);
       }
       return -ENOSYS;
     }
 
+    int getattr(const char* path, struct stat* buffer) {
+      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
+      scoped_flight flight(get_flights(self), path, dispatch::getattr, std::string());
+      if (flight.follower()) {
+        return flight.copy(buffer, sizeof(*buffer));
+      }
+      return flight.set(getattr_impl(path, buffer), buffer, sizeof(*buffer));
+    }
+
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/readlink.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L97
-    int readlink(const char* path, char* buffer, size_t size) {
+    int readlink_impl(const char* path, char* buffer, size_t size) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      memo_cache* memos = get_memos(self);
+      std::string key;
+      uint64_t generation = 0;
+      if (memos) {
+        key = memo_cache::key(path, dispatch::readlink, std::string());
+        std::string data;
+        int result = 0;
+        if (memos->get(key, &data, &result)) {
+          if (result == 0) {
+            memset(buffer, 0, size);
+            memcpy(buffer, data.data(), std::min(size - 1, data.size()));
+          }
+          return result;
+        }
+        generation = memos->generation();
+      }
+      managed_state state(self->manager(dispatch::readlink), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "readlink")) {
+      if (prepare(L, save.get(), dispatch::readlink)) {
         luaX_push(L, path, size);
-        if (lua_pcall(L, 3, 1, 0) == 0) {
+        if (lua_pcall(L, 3, memos ? 2 : 1, 0) == 0) {
+          double ttl = memos ? self->options().memo_timeout : 0;
+          if (memos) {
+            if (lua_isnumber(L, -1)) {
+              ttl = lua_tonumber(L, -1);
+            }
+            lua_pop(L, 1);
+          }
+          // an error returned is memoized as one raised, with the timeout
+          // returned beside it.
           if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
+            int result = lua_tointeger(L, -1);
+            if (memos && result < 0 && is_memoizable(result)) {
+              memos->put(key, std::string(), result, ttl, generation);
+            }
+            return result;
           } else if (luaX_string_reference result = luaX_to_string(L, -1)) {
+            if (memos) {
+              memos->put(key, std::string(result.data(), result.size()), 0, ttl, generation);
+            }
             memset(buffer, 0, size);
             memcpy(buffer, result.data(), std::min(size - 1, result.size()));
             return 0;
@@ -138,7 +613,11 @@ namespace dromozoa {
           DROMOZOA_UNEXPECTED("must return a string");
         } else {
           if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
+            int result = lua_tointeger(L, -1);
+            if (memos && is_memoizable(result)) {
+              memos->put(key, std::string(), result, self->options().memo_timeout, generation);
+            }
+            return result;
           }
           DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
         }
@@ -146,14 +625,27 @@ namespace dromozoa {
       return -ENOSYS;
     }
 
+    int readlink(const char* path, char* buffer, size_t size) {
+      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
+      scoped_flight flight(get_flights(self), path, dispatch::readlink, flight_args(size));
+      if (flight.follower()) {
+        return flight.copy(buffer, size);
+      }
+      return flight.set(readlink_impl(path, buffer, size), buffer, size);
+    }
+
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/mknod.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L110
     int mknod(const char* path, mode_t mode, dev_t dev) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path, true);
+      managed_state state(self->manager(dispatch::mknod), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "mknod")) {
+      if (prepare(L, save.get(), dispatch::mknod)) {
         luaX_push(L, path, mode, dev);
         return call(L, 4);
       }
@@ -164,10 +656,14 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L118
     int mkdir(const char* path, mode_t mode) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path, true);
+      managed_state state(self->manager(dispatch::mkdir), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "mkdir")) {
+      if (prepare(L, save.get(), dispatch::mkdir)) {
         luaX_push(L, path, mode);
         return call(L, 3);
       }
@@ -178,10 +674,17 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L126
     int unlink(const char* path) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      if (int result = flush_writes(self, path, 0, 0)) {
+        return result;
+      }
+      scoped_invalidation invalidation(self, path, true);
+      managed_state state(self->manager(dispatch::unlink), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "unlink")) {
+      if (prepare(L, save.get(), dispatch::unlink)) {
         luaX_push(L, path);
         return call(L, 2);
       }
@@ -192,10 +695,14 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L129
     int rmdir(const char* path) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path, true);
+      managed_state state(self->manager(dispatch::rmdir), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "rmdir")) {
+      if (prepare(L, save.get(), dispatch::rmdir)) {
         luaX_push(L, path);
         return call(L, 2);
       }
@@ -206,10 +713,14 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L132
     int symlink(const char* target, const char* path) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path, true);
+      managed_state state(self->manager(dispatch::symlink), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "symlink")) {
+      if (prepare(L, save.get(), dispatch::symlink)) {
         luaX_push(L, target, path);
         return call(L, 3);
       }
@@ -220,10 +731,26 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L135
     int rename(const char* oldpath, const char* newpath) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      // the buffers of a replaced newpath would be written into the renamed
+      // file later.
+      int result = flush_writes(self, oldpath, 0, 0);
+      if (int written = flush_writes(self, newpath, 0, 0)) {
+        if (result == 0) {
+          result = written;
+        }
+      }
+      if (result) {
+        return result;
+      }
+      scoped_invalidation invalidation1(self, oldpath, true, true);
+      scoped_invalidation invalidation2(self, newpath, true, true);
+      managed_state state(self->manager(dispatch::rename), oldpath, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "rename")) {
+      if (prepare(L, save.get(), dispatch::rename)) {
         luaX_push(L, oldpath, newpath);
         return call(L, 3);
       }
@@ -234,10 +761,15 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L138
     int link(const char* oldpath, const char* newpath) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation1(self, oldpath);
+      scoped_invalidation invalidation2(self, newpath, true);
+      managed_state state(self->manager(dispatch::link), oldpath, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "link")) {
+      if (prepare(L, save.get(), dispatch::link)) {
         luaX_push(L, oldpath, newpath);
         return call(L, 3);
       }
@@ -248,10 +780,15 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L141
     int chmod(const char* path, mode_t mode) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path);
+      invalidation.permissions();
+      managed_state state(self->manager(dispatch::chmod), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "chmod")) {
+      if (prepare(L, save.get(), dispatch::chmod)) {
         luaX_push(L, path, mode);
         return call(L, 3);
       }
@@ -262,10 +799,15 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L144
     int chown(const char* path, uid_t uid, gid_t gid) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path);
+      invalidation.permissions();
+      managed_state state(self->manager(dispatch::chown), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "chown")) {
+      if (prepare(L, save.get(), dispatch::chown)) {
         luaX_push(L, path, uid, gid);
         return call(L, 4);
       }
@@ -276,10 +818,17 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L147
     int truncate(const char* path, off_t size) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      if (int result = flush_writes(self, path, 0, 0)) {
+        return result;
+      }
+      scoped_invalidation invalidation(self, path);
+      managed_state state(self->manager(dispatch::truncate), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "truncate")) {
+      if (prepare(L, save.get(), dispatch::truncate)) {
         luaX_push(L, path, size);
         return call(L, 3);
       }
@@ -290,36 +839,65 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L156
     int open(const char* path, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      managed_state state(self->manager(dispatch::open), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "open")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::open)) {
         luaX_push(L, path);
         lua_pushvalue(L, info.index());
-        return call(L, 3);
+        disk_cache* disk = get_disk(self);
+        std::string token;
+        int result = call(L, 3, 0, 0, disk ? &token : 0);
+        if (result == 0) {
+          state.attach(info_ptr);
+          if (disk && !token.empty() && disk->validate(path, token)) {
+            self->blocks()->invalidate(path, false);
+          }
+        }
+        return result;
       }
       return -ENOSYS;
     }
 
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/read.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L175
-    int read(const char* path, char* buffer, size_t size, off_t offset, struct fuse_file_info* info_ptr) {
-      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+    int read_handler(operations* self, const char* path, char* buffer, size_t size, off_t offset, struct fuse_file_info* info_ptr) {
+      managed_state state(self->manager(dispatch::read), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "read")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::read)) {
+        if (self->options().use_read_buffer) {
+          // the handler fills the buffer in place and returns the byte count.
+          luaX_push(L, path);
+          scoped_handle scope(new_buffer(L, buffer, size));
+          luaX_push(L, offset);
+          lua_pushvalue(L, info.index());
+          int result = call(L, 5);
+          if (result > 0 && static_cast<size_t>(result) > size) {
+            DROMOZOA_UNEXPECTED("out of bounds");
+            return -EIO;
+          }
+          return result;
+        }
         luaX_push(L, path, size, offset);
         lua_pushvalue(L, info.index());
         if (lua_pcall(L, 5, 1, 0) == 0) {
           if (luaX_is_integer(L, -1)) {
             return lua_tointeger(L, -1);
           } else if (luaX_string_reference result = luaX_to_string(L, -1)) {
-            memset(buffer, 0, size);
-            memcpy(buffer, result.data(), std::min(size, result.size()));
-            return result.size();
+            // the kernel uses only the returned bytes, so the tail is left
+            // untouched.
+            size_t n = std::min(size, result.size());
+            memcpy(buffer, result.data(), n);
+            return n;
           }
           DROMOZOA_UNEXPECTED("must return a string");
         } else {
@@ -332,71 +910,224 @@ namespace dromozoa {
       return -ENOSYS;
     }
 
-    // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/write.2.html
-    // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L189
+    // reads the block from the disk cache or the handler, and keeps it in the
+    // caches.
+    int read_block_impl(operations* self, const char* path, uint64_t index, struct fuse_file_info* info_ptr, std::string* data) {
+      block_cache* blocks = get_blocks(self);
+      disk_cache* disk = get_disk(self);
+      size_t block_size = self->blocks()->block_size();
+      uint64_t generation = blocks ? blocks->generation() : 0;
+      uint64_t disk_generation = disk ? disk->generation() : 0;
+      if (!disk || !disk->get(path, index, data)) {
+        std::vector<char> block(block_size);
+        int result = read_handler(self, path, &block[0], block_size, index * block_size, info_ptr);
+        if (result < 0) {
+          return result;
+        }
+        data->assign(&block[0], result);
+        if (disk) {
+          disk->put(path, index, *data, disk_generation);
+        }
+      }
+      if (blocks) {
+        blocks->put(path, index, *data, generation);
+      }
+      return 0;
+    }
+
+    // a foreground read of a block also waits for its readahead in flight.
+    int read_block(operations* self, const char* path, uint64_t index, struct fuse_file_info* info_ptr, std::string* data) {
+      scoped_flight flight(get_flights(self), path, dispatch::read, flight_args(index));
+      if (flight.follower()) {
+        *data = flight.data();
+        return flight.result();
+      }
+      int result = read_block_impl(self, path, index, info_ptr, data);
+      return flight.set(result, data->data(), data->size());
+    }
+
+    // called on the threads of the readahead queue.
+    int prefetch_block(operations* self, const char* path, uint64_t index, struct fuse_file_info* info_ptr) {
+      if (self->blocks()->contains(path, index)) {
+        return readahead_queue::fetch_cached;
+      }
+      std::string data;
+      if (int result = read_block(self, path, index, info_ptr, &data)) {
+        return result;
+      }
+      return data.size() < self->blocks()->block_size() ? readahead_queue::fetch_short : readahead_queue::fetch_full;
+    }
+
+    readahead_queue* get_readahead(operations* self) {
+      return self->readahead()->enabled() ? self->readahead() : 0;
+    }
+
+    // whole blocks are read by the handler and served from the block cache,
+    // then from the disk cache.  a block shorter than the block size ends the
+    // file.  files opened with direct_io bypass the caches.  sequential reads
+    // of an open file start the readahead of the next blocks.
+    int read(const char* path, char* buffer, size_t size, off_t offset, struct fuse_file_info* info_ptr) {
+      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
+      if (int result = flush_writes(self, path, offset, size)) {
+        return result;
+      }
+      block_cache* blocks = get_blocks(self);
+      disk_cache* disk = get_disk(self);
+      if ((!blocks && !disk) || !path || offset < 0 || (info_ptr && info_ptr->direct_io)) {
+        // only reads aligned to their size are coalesced without the caches.
+        singleflight* flights = path && offset >= 0 && size > 0 && offset % size == 0 && !(info_ptr && info_ptr->direct_io) ? get_flights(self) : 0;
+        scoped_flight flight(flights, path, dispatch::read, flight_args(offset, size));
+        if (flight.follower()) {
+          return flight.copy(buffer, size);
+        }
+        int result = read_handler(self, path, buffer, size, offset, info_ptr);
+        return flight.set(result, buffer, std::max(result, 0));
+      }
+      size_t block_size = self->blocks()->block_size();
+      size_t n = 0;
+      while (n < size) {
+        uint64_t position = offset + n;
+        uint64_t index = position / block_size;
+        size_t skip = position % block_size;
+        std::string data;
+        if (!blocks || !blocks->get(path, index, &data)) {
+          if (int result = read_block(self, path, index, info_ptr, &data)) {
+            if (n > 0) {
+              break;
+            }
+            return result;
+          }
+        }
+        if (data.size() <= skip) {
+          break;
+        }
+        size_t m = std::min(size - n, data.size() - skip);
+        memcpy(buffer + n, data.data() + skip, m);
+        n += m;
+        if (data.size() < block_size) {
+          break;
+        }
+      }
+      if (readahead_queue* readahead = get_readahead(self)) {
+        readahead->access(path, info_ptr, offset, n, block_size);
+      }
+      return n;
+    }
+
+    // small contiguous writes are gathered by the write coalescer and written
+    // by one call to the handler.  with write-behind, the call is made on a
+    // background thread after write has returned.
     int write(const char* path, const char* buffer, size_t size, off_t offset, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
-      lua_State* L = state.get();
-      luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "write")) {
-        luaX_push(L, path, luaX_string_reference(buffer, size), offset);
-        lua_pushvalue(L, info.index());
-        return call(L, 5, size);
+      write_coalescer* writes = get_writes(self);
+      write_behind* behind = get_behind(self);
+      if ((!writes && !behind) || !path || !info_ptr) {
+        return write_handler(self, path, buffer, size, offset, info_ptr);
       }
-      return -ENOSYS;
+      std::vector<write_coalescer::chunk> chunks;
+      bool buffered = writes && writes->add(path, info_ptr, buffer, size, offset, &chunks);
+      if (int result = write_chunks(self, chunks)) {
+        if (buffered) {
+          std::vector<write_coalescer::chunk> dropped;
+          writes->take(path, info_ptr->fh, &dropped);
+        }
+        return result;
+      }
+      if (buffered) {
+        return size;
+      }
+      if (behind) {
+        write_coalescer::chunk chunk;
+        chunk.path = path;
+        chunk.info = *info_ptr;
+        chunk.offset = offset;
+        chunk.data.assign(buffer, size);
+        chunk.time = 0;
+        if (behind->push(chunk)) {
+          return size;
+        }
+      }
+      return write_handler(self, path, buffer, size, offset, info_ptr);
     }
 
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/statvfs.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L200
     int statfs(const char* path, struct statvfs* buffer) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      memo_cache* memos = get_memos(self);
+      std::string key;
+      uint64_t generation = 0;
+      if (memos) {
+        key = memo_cache::key(path, dispatch::statfs, std::string());
+        std::string data;
+        int result = 0;
+        if (memos->get(key, &data, &result)) {
+          if (result == 0) {
+            memcpy(buffer, data.data(), sizeof(*buffer));
+          }
+          return result;
+        }
+        generation = memos->generation();
+      }
+      managed_state state(self->manager(dispatch::statfs), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "statfs")) {
+      if (prepare(L, save.get(), dispatch::statfs)) {
         luaX_push(L, path);
-        if (lua_pcall(L, 2, 1, 0) == 0) {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          } else if (convert(L, -1, buffer)) {
-            return 0;
-          }
-          DROMOZOA_UNEXPECTED("must return a table");
-        } else {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          }
-          DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
+        if (!memos) {
+          return call_struct(L, 2, buffer, self->options().use_views);
+        }
+        double ttl = self->options().memo_timeout;
+        int result = call_struct(L, 2, buffer, self->options().use_views, &ttl);
+        if (result == 0) {
+          memos->put(key, std::string(reinterpret_cast<const char*>(buffer), sizeof(*buffer)), 0, ttl, generation);
         }
+        return result;
       }
       return -ENOSYS;
     }
 
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L209
+    // buffered writes of the handle are written first, and their error is
+    // reported here.  without a handler, flush is registered only for them.
     int flush(const char* path, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      int written = flush_writes(self, path, info_ptr);
+      managed_state state(self->manager(dispatch::flush), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "flush")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::flush)) {
         luaX_push(L, path);
         lua_pushvalue(L, info.index());
-        return call(L, 3);
+        int result = call(L, 3);
+        return written < 0 ? written : result;
       }
-      return -ENOSYS;
+      return get_writes(self) || get_behind(self) ? written : -ENOSYS;
     }
 
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L234
     int release(const char* path, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      if (readahead_queue* readahead = get_readahead(self)) {
+        readahead->close(path, info_ptr->fh);
+      }
+      flush_writes(self, path, info_ptr);
+      managed_state state(self->manager(dispatch::release), path, info_ptr);
+      state.detach(info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "release")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::release)) {
         luaX_push(L, path);
         lua_pushvalue(L, info.index());
         return call(L, 3);
@@ -404,20 +1135,126 @@ namespace dromozoa {
       return -ENOSYS;
     }
 
+    group_commit* get_commits(operations* self, dispatch::code code) {
+      return self->options().group_commit ? self->commits(code) : 0;
+    }
+
+    // the handler of a group commit receives the paths, datasync and the file
+    // infos of the members, with false for a member without one.  datasync is
+    // zero unless every member asked for it.  an integer applies to every
+    // member and a table gives the result of each.
+    void commit_group(lua_State* L, dispatch::code op, std::vector<group_commit::member>& members, const std::vector<size_t>& group) {
+      int result = -ENOSYS;
+      luaX_top_saver save(L);
+      if (prepare(L, save.get(), op)) {
+        int datasync = 1;
+        lua_newtable(L);
+        for (size_t i = 0; i < group.size(); ++i) {
+          luaX_set_field(L, -1, i + 1, members[group[i]].path);
+          if (!members[group[i]].datasync) {
+            datasync = 0;
+          }
+        }
+        luaX_push(L, datasync);
+        lua_newtable(L);
+        for (size_t i = 0; i < group.size(); ++i) {
+          if (members[group[i]].has_info) {
+            convert(L, &members[group[i]].info);
+          } else {
+            lua_pushboolean(L, false);
+          }
+          luaX_set_field(L, -2, i + 1);
+        }
+        if (lua_pcall(L, 4, 1, 0) == 0) {
+          if (lua_istable(L, -1)) {
+            for (size_t i = 0; i < group.size(); ++i) {
+              luaX_get_field(L, -1, i + 1);
+              members[group[i]].result = luaX_is_integer(L, -1) ? lua_tointeger(L, -1) : 0;
+              lua_pop(L, 1);
+            }
+            return;
+          } else if (luaX_is_integer(L, -1)) {
+            result = lua_tointeger(L, -1);
+          } else if (lua_isnil(L, -1)) {
+            result = 0;
+          } else {
+            DROMOZOA_UNEXPECTED("must return an integer or a table");
+          }
+        } else {
+          if (luaX_is_integer(L, -1)) {
+            result = lua_tointeger(L, -1);
+          } else {
+            DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
+          }
+        }
+      }
+      for (size_t i = 0; i < group.size(); ++i) {
+        members[group[i]].result = result;
+      }
+    }
+
+    // the members which the manager routes to the state of the first one are
+    // committed together on it, and the others in later groups, so that each
+    // handle reaches the state which opened it.
+    void commit_batch(operations* self, int code, std::vector<group_commit::member>& members) {
+      dispatch::code op = static_cast<dispatch::code>(code);
+      state_manager* manager = self->manager(op);
+      std::vector<size_t> rest;
+      for (size_t i = 0; i < members.size(); ++i) {
+        rest.push_back(i);
+      }
+      while (!rest.empty()) {
+        group_commit::member& first = members[rest.front()];
+        managed_state state(manager, first.path.c_str(), first.has_info ? &first.info : 0);
+        lua_State* L = state.get();
+        if (!L) {
+          for (size_t i = 0; i < rest.size(); ++i) {
+            members[rest[i]].result = state.result();
+          }
+          return;
+        }
+        std::vector<size_t> group;
+        std::vector<size_t> next;
+        for (size_t i = 0; i < rest.size(); ++i) {
+          group_commit::member& that = members[rest[i]];
+          if (i == 0 || manager->shares_route(L, that.path.c_str(), that.has_info ? &that.info : 0)) {
+            group.push_back(rest[i]);
+          } else {
+            next.push_back(rest[i]);
+          }
+        }
+        commit_group(L, op, members, group);
+        rest.swap(next);
+      }
+    }
+
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/fsync.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L250
+    // buffered writes of the handle are written first, as in flush.
     int fsync(const char* path, int datasync, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      int written = flush_writes(self, path, info_ptr);
+      if (group_commit* commits = get_commits(self, dispatch::fsync)) {
+        int result = commits->commit(self, commit_batch, path, datasync, info_ptr);
+        if (result == -ENOSYS && (get_writes(self) || get_behind(self))) {
+          result = 0;
+        }
+        return written < 0 ? written : result;
+      }
+      managed_state state(self->manager(dispatch::fsync), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "fsync")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::fsync)) {
         luaX_push(L, path, datasync);
         lua_pushvalue(L, info.index());
-        return call(L, 4);
+        int result = call(L, 4);
+        return written < 0 ? written : result;
       }
-      return -ENOSYS;
+      return get_writes(self) || get_behind(self) ? written : -ENOSYS;
     }
 
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/setxattr.2.html
@@ -430,10 +1267,14 @@ namespace dromozoa {
       static const luaX_nil_t position = luaX_nil;
 #endif
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path);
+      managed_state state(self->manager(dispatch::setxattr), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "setxattr")) {
+      if (prepare(L, save.get(), dispatch::setxattr)) {
         luaX_push(L, path, name, luaX_string_reference(buffer, size), flags, position);
         return call(L, 6);
       }
@@ -444,66 +1285,83 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L263
     // https://github.com/osxfuse/fuse/blob/master/example/fusexmp_fh.c#L817
 #ifdef __APPLE__
-    int getxattr(const char* path, const char* name, char* buffer, size_t size, uint32_t position) {
+    int getxattr_impl(const char* path, const char* name, char* buffer, size_t size, uint32_t position) {
 #else
-    int getxattr(const char* path, const char* name, char* buffer, size_t size) {
+    int getxattr_impl(const char* path, const char* name, char* buffer, size_t size) {
       static const luaX_nil_t position = luaX_nil;
 #endif
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      xattr_cache* xattrs = get_xattrs(self);
+#ifdef __APPLE__
+      if (position != 0) {
+        xattrs = 0;
+      }
+#endif
+      int result = 0;
+      if (xattrs && xattrs->get(path, name, buffer, size, &result)) {
+        return result;
+      }
+      uint64_t generation = xattrs ? xattrs->generation() : 0;
+      managed_state state(self->manager(dispatch::getxattr), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "getxattr")) {
+      if (prepare(L, save.get(), dispatch::getxattr)) {
         luaX_push(L, path, name, size, position);
-        if (lua_pcall(L, 5, 1, 0) == 0) {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          } else if (luaX_string_reference result = luaX_to_string(L, -1)) {
-            if (result.size() > size) {
-              return -ERANGE;
-            }
-            memset(buffer, 0, size);
-            memcpy(buffer, result.data(), result.size());
-            return result.size();
-          }
-          DROMOZOA_UNEXPECTED("must return a string");
-        } else {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          }
-          DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
-        }
+        return call_xattr(L, 5, buffer, size, xattrs, path, name, generation);
       }
       return -ENOSYS;
     }
 
+    // the result is shared only with callers of the same name and size.
+#ifdef __APPLE__
+    int getxattr(const char* path, const char* name, char* buffer, size_t size, uint32_t position) {
+#else
+    int getxattr(const char* path, const char* name, char* buffer, size_t size) {
+#endif
+      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
+      singleflight* flights = get_flights(self);
+#ifdef __APPLE__
+      if (position != 0) {
+        flights = 0;
+      }
+#endif
+      std::string args(name);
+      args += '\0';
+      args += flight_args(size);
+      scoped_flight flight(flights, path, dispatch::getxattr, args);
+      if (flight.follower()) {
+        return flight.copy(buffer, size);
+      }
+#ifdef __APPLE__
+      int result = getxattr_impl(path, name, buffer, size, position);
+#else
+      int result = getxattr_impl(path, name, buffer, size);
+#endif
+      return flight.set(result, buffer, size > 0 ? std::max(result, 0) : 0);
+    }
+
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/listxattr.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L265
     int listxattr(const char* path, char* buffer, size_t size) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      xattr_cache* xattrs = get_xattrs(self);
+      int result = 0;
+      if (xattrs && xattrs->get(path, 0, buffer, size, &result)) {
+        return result;
+      }
+      uint64_t generation = xattrs ? xattrs->generation() : 0;
+      managed_state state(self->manager(dispatch::listxattr), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "listxattr")) {
+      if (prepare(L, save.get(), dispatch::listxattr)) {
         luaX_push(L, path, size);
-        if (lua_pcall(L, 3, 1, 0) == 0) {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          } else if (luaX_string_reference result = luaX_to_string(L, -1)) {
-            if (result.size() > size) {
-              return -ERANGE;
-            }
-            memset(buffer, 0, size);
-            memcpy(buffer, result.data(), result.size());
-            return result.size();
-          }
-          DROMOZOA_UNEXPECTED("must return a string");
-        } else {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          }
-          DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
-        }
+        return call_xattr(L, 3, buffer, size, xattrs, path, 0, generation);
       }
       return -ENOSYS;
     }
@@ -512,10 +1370,14 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L268
     int removexattr(const char* path, const char* name) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path);
+      managed_state state(self->manager(dispatch::removexattr), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "removexattr")) {
+      if (prepare(L, save.get(), dispatch::removexattr)) {
         luaX_push(L, path, name);
         return call(L, 3);
       }
@@ -525,14 +1387,21 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L271
     int opendir(const char* path, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      managed_state state(self->manager(dispatch::opendir), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "opendir")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::opendir)) {
         luaX_push(L, path);
         lua_pushvalue(L, info.index());
-        return call(L, 3);
+        int result = call(L, 3);
+        if (result == 0) {
+          state.attach(info_ptr);
+        }
+        return result;
       }
       return -ENOSYS;
     }
@@ -540,11 +1409,14 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L283
     int readdir(const char* path, void* buffer, fuse_fill_dir_t function, off_t offset, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      managed_state state(self->manager(dispatch::readdir), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "readdir")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::readdir)) {
         luaX_push(L, path);
         scoped_handle scope(new_fill_dir(L, function, buffer));
         luaX_push(L, offset);
@@ -557,11 +1429,15 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L309
     int releasedir(const char* path, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      managed_state state(self->manager(dispatch::releasedir), path, info_ptr);
+      state.detach(info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "releasedir")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::releasedir)) {
         luaX_push(L, path);
         lua_pushvalue(L, info.index());
         return call(L, 3);
@@ -572,11 +1448,17 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L313
     int fsyncdir(const char* path, int datasync, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      if (group_commit* commits = get_commits(self, dispatch::fsyncdir)) {
+        return commits->commit(self, commit_batch, path, datasync, info_ptr);
+      }
+      managed_state state(self->manager(dispatch::fsyncdir), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "fsyncdir")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::fsyncdir)) {
         luaX_push(L, path, datasync);
         lua_pushvalue(L, info.index());
         return call(L, 4);
@@ -585,13 +1467,21 @@ namespace dromozoa {
     }
 
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L322
+    // the threads of the readahead queue and write-behind are started here,
+    // after fuse_main has daemonized the process.
     void* init(struct fuse_conn_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      self->readahead()->start(self, prefetch_block);
+      self->behind()->start(self, write_chunk);
+      managed_state state(self->manager(dispatch::init));
       lua_State* L = state.get();
+      if (!L) {
+        DROMOZOA_UNEXPECTED("could not open state");
+        return self;
+      }
       luaX_top_saver save(L);
       conn_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "init")) {
+      if (prepare(L, save.get(), dispatch::init)) {
         lua_pushvalue(L, info.index());
         if (lua_pcall(L, 2, 0, 0) != 0) {
           DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
@@ -603,10 +1493,21 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L334
     void destroy(void* userdata) {
       scoped_ptr<operations> self(static_cast<operations*>(userdata));
-      managed_state state(self->manager());
+      self->readahead()->stop();
+      if (write_coalescer* writes = get_writes(self.get())) {
+        std::vector<write_coalescer::chunk> chunks;
+        writes->take(&chunks);
+        write_chunks(self.get(), chunks);
+      }
+      self->behind()->stop();
+      managed_state state(self->manager(dispatch::destroy));
       lua_State* L = state.get();
+      if (!L) {
+        DROMOZOA_UNEXPECTED("could not open state");
+        return;
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "destroy")) {
+      if (prepare(L, save.get(), dispatch::destroy)) {
         if (lua_pcall(L, 1, 0, 0) != 0) {
           DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
         }
@@ -616,13 +1517,40 @@ namespace dromozoa {
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/access.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L343
     int access(const char* path, int mode) {
-      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      struct fuse_context* context = fuse_get_context();
+      operations* self = static_cast<operations*>(context->private_data);
+      memo_cache* memos = get_memos(self);
+      std::string key;
+      uint64_t generation = 0;
+      if (memos) {
+        // the result depends on the caller.
+        std::ostringstream out;
+        out << mode << ":" << context->uid << ":" << context->gid;
+        key = memo_cache::key(path, dispatch::access, out.str());
+        std::string data;
+        int result = 0;
+        if (memos->get(key, &data, &result)) {
+          return result;
+        }
+        generation = memos->generation();
+      }
+      managed_state state(self->manager(dispatch::access), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "access")) {
+      if (prepare(L, save.get(), dispatch::access)) {
         luaX_push(L, path, mode);
-        return call(L, 3);
+        if (!memos) {
+          return call(L, 3);
+        }
+        double ttl = self->options().memo_timeout;
+        int result = call(L, 3, 0, &ttl);
+        if (is_memoizable(result)) {
+          memos->put(key, std::string(), result, ttl, generation);
+        }
+        return result;
       }
       return -ENOSYS;
     }
@@ -630,14 +1558,22 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L356
     int create(const char* path, mode_t mode, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path, true);
+      managed_state state(self->manager(dispatch::create), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "create")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::create)) {
         luaX_push(L, path, mode);
         lua_pushvalue(L, info.index());
-        return call(L, 4);
+        int result = call(L, 4);
+        if (result == 0) {
+          state.attach(info_ptr);
+        }
+        return result;
       }
       return -ENOSYS;
     }
@@ -646,11 +1582,18 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L370
     int ftruncate(const char* path, off_t size, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      if (int result = flush_writes(self, path, 0, 0)) {
+        return result;
+      }
+      scoped_invalidation invalidation(self, path);
+      managed_state state(self->manager(dispatch::ftruncate), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "ftruncate")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::ftruncate)) {
         luaX_push(L, path, size);
         lua_pushvalue(L, info.index());
         return call(L, 4);
@@ -662,26 +1605,26 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L384
     int fgetattr(const char* path, struct stat* buffer, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      if (int result = flush_writes(self, path, 0, 0)) {
+        return result;
+      }
+      attr_cache* attrs = path ? get_attrs(self) : 0;
+      int result = 0;
+      if (attrs && attrs->get(path, buffer, &result)) {
+        return result;
+      }
+      uint64_t generation = attrs ? attrs->generation() : 0;
+      managed_state state(self->manager(dispatch::fgetattr), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "fgetattr")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::fgetattr)) {
         luaX_push(L, path);
         lua_pushvalue(L, info.index());
-        if (lua_pcall(L, 3, 1, 0) == 0) {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          } else if (convert(L, -1, buffer)) {
-            return 0;
-          }
-          DROMOZOA_UNEXPECTED("must return a table");
-        } else {
-          if (luaX_is_integer(L, -1)) {
-            return lua_tointeger(L, -1);
-          }
-          DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
-        }
+        return call_attr(L, 3, path, buffer, self, attrs, generation);
       }
       return -ENOSYS;
     }
@@ -690,12 +1633,15 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L398
     int lock(const char* path, struct fuse_file_info* info_ptr, int command, struct flock* flock_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      managed_state state(self->manager(dispatch::lock), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
+      file_info_t info(L, info_ptr, self->options().use_views);
       flock_t flock(L, flock_ptr);
-      if (prepare(L, save.get(), "lock")) {
+      if (prepare(L, save.get(), dispatch::lock)) {
         luaX_push(L, path);
         lua_pushvalue(L, info.index());
         luaX_push(L, command);
@@ -709,10 +1655,14 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L433
     int utimens(const char* path, const struct timespec times[2]) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path);
+      managed_state state(self->manager(dispatch::utimens), path, 0);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      if (prepare(L, save.get(), "utimens")) {
+      if (prepare(L, save.get(), dispatch::utimens)) {
         luaX_push(L, path);
         if (times) {
           convert(L, &times[0]);
@@ -739,25 +1689,221 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L508
     // poll
 
-    // TODO impl?
-    // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/write.2.html
-    // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L528
-    // write_buf (2.9)
+#if FUSE_VERSION >= 29
+    // libfuse frees the bufvec and its memory buffers with free(3).
+    struct fuse_bufvec* new_bufvec(size_t size) {
+      struct fuse_bufvec* bufvec = static_cast<struct fuse_bufvec*>(malloc(sizeof(struct fuse_bufvec)));
+      if (bufvec) {
+        memset(bufvec, 0, sizeof(*bufvec));
+        bufvec->count = 1;
+        bufvec->buf[0].size = size;
+        bufvec->buf[0].fd = -1;
+        if (size > 0) {
+          bufvec->buf[0].mem = malloc(size);
+          if (!bufvec->buf[0].mem) {
+            free(bufvec);
+            return 0;
+          }
+        }
+      }
+      return bufvec;
+    }
+
+    // sets fallback when the handler returned nil to fall back to read.
+    int read_buf_impl(const char* path, struct fuse_bufvec** bufp, size_t size, off_t offset, struct fuse_file_info* info_ptr, bool* fallback) {
+      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
+      managed_state state(self->manager(dispatch::read_buf), path, info_ptr);
+      lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
+      luaX_top_saver save(L);
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::read_buf)) {
+        luaX_push(L, path, size, offset);
+        lua_pushvalue(L, info.index());
+        if (lua_pcall(L, 5, 3, 0) == 0) {
+          if (lua_isnil(L, -3)) {
+            *fallback = true;
+            return 0;
+          } else if (luaX_is_integer(L, -3) && luaX_is_integer(L, -2)) {
+            // the file descriptor must stay open until the reply is sent,
+            // that is, until the handler of release is called.
+            int fd = lua_tointeger(L, -3);
+            off_t position = lua_tointeger(L, -2);
+            if (fd < 0 || position < 0) {
+              DROMOZOA_UNEXPECTED("out of bounds");
+              return -EIO;
+            }
+            if (luaX_is_integer(L, -1)) {
+              lua_Integer n = lua_tointeger(L, -1);
+              if (n < 0) {
+                DROMOZOA_UNEXPECTED("out of bounds");
+                return -EIO;
+              }
+              size = std::min(size, static_cast<size_t>(n));
+            }
+            struct fuse_bufvec* bufvec = new_bufvec(0);
+            if (!bufvec) {
+              return -ENOMEM;
+            }
+            bufvec->buf[0].size = size;
+            bufvec->buf[0].flags = static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK | FUSE_BUF_FD_RETRY);
+            bufvec->buf[0].fd = fd;
+            bufvec->buf[0].pos = position;
+            *bufp = bufvec;
+            return 0;
+          } else if (luaX_is_integer(L, -3)) {
+            return lua_tointeger(L, -3);
+          } else if (luaX_string_reference result = luaX_to_string(L, -3)) {
+            size = std::min(size, result.size());
+            struct fuse_bufvec* bufvec = new_bufvec(size);
+            if (!bufvec) {
+              return -ENOMEM;
+            }
+            memcpy(bufvec->buf[0].mem, result.data(), size);
+            *bufp = bufvec;
+            return 0;
+          }
+          DROMOZOA_UNEXPECTED("must return a file descriptor or a string");
+        } else {
+          if (luaX_is_integer(L, -1)) {
+            return lua_tointeger(L, -1);
+          }
+          DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
+        }
+      }
+      return -ENOSYS;
+    }
 
-    // TODO impl?
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/read.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L539
-    // read_buf (2.9)
+    int read_buf(const char* path, struct fuse_bufvec** bufp, size_t size, off_t offset, struct fuse_file_info* info_ptr) {
+      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
+      if (int result = flush_writes(self, path, offset, size)) {
+        return result;
+      }
+      bool fallback = false;
+      int result = read_buf_impl(path, bufp, size, offset, info_ptr, &fallback);
+      if (!fallback) {
+        return result;
+      }
+      // the state is released before read opens one again.
+      struct fuse_bufvec* bufvec = new_bufvec(size);
+      if (!bufvec) {
+        return -ENOMEM;
+      }
+      result = read(path, static_cast<char*>(bufvec->buf[0].mem), size, offset, info_ptr);
+      if (result < 0) {
+        free(bufvec->buf[0].mem);
+        free(bufvec);
+        return result;
+      }
+      bufvec->buf[0].size = result;
+      *bufp = bufvec;
+      return 0;
+    }
+
+    // sets fallback when the handler returned nil to fall back to write, or
+    // sets fd and position when the handler named a destination.
+    int write_buf_impl(const char* path, size_t size, off_t offset, struct fuse_file_info* info_ptr, bool* fallback, int* fd, off_t* position) {
+      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
+      managed_state state(self->manager(dispatch::write_buf), path, info_ptr);
+      lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
+      luaX_top_saver save(L);
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::write_buf)) {
+        luaX_push(L, path, size, offset);
+        lua_pushvalue(L, info.index());
+        if (lua_pcall(L, 5, 2, 0) == 0) {
+          if (lua_isnil(L, -2)) {
+            *fallback = true;
+            return 0;
+          } else if (luaX_is_integer(L, -2) && luaX_is_integer(L, -1)) {
+            *fd = lua_tointeger(L, -2);
+            *position = lua_tointeger(L, -1);
+            if (*fd < 0 || *position < 0) {
+              DROMOZOA_UNEXPECTED("out of bounds");
+              return -EIO;
+            }
+            return 0;
+          } else if (luaX_is_integer(L, -2)) {
+            return lua_tointeger(L, -2);
+          }
+          DROMOZOA_UNEXPECTED("must return a file descriptor");
+        } else {
+          if (luaX_is_integer(L, -1)) {
+            return lua_tointeger(L, -1);
+          }
+          DROMOZOA_UNEXPECTED(lua_tostring(L, -1));
+        }
+      }
+      return -ENOSYS;
+    }
+
+    // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/write.2.html
+    // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L528
+    int write_buf(const char* path, struct fuse_bufvec* buf, off_t offset, struct fuse_file_info* info_ptr) {
+      operations* self = static_cast<operations*>(fuse_get_context()->private_data);
+      scoped_invalidation invalidation(self, path);
+      size_t size = fuse_buf_size(buf);
+      invalidation.range(offset, size);
+      // buffered and queued writes must not be overtaken by a transfer to a
+      // file descriptor, so they take every write.
+      bool fallback = get_writes(self) || get_behind(self);
+      int fd = -1;
+      off_t position = 0;
+      int result = fallback ? 0 : write_buf_impl(path, size, offset, info_ptr, &fallback, &fd, &position);
+      if (fd >= 0) {
+        // the state is released before the transfer, which libfuse does with
+        // splice(2) when the source is the pipe of the device.
+        struct fuse_bufvec dst;
+        memset(&dst, 0, sizeof(dst));
+        dst.count = 1;
+        dst.buf[0].size = size;
+        dst.buf[0].flags = static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK | FUSE_BUF_FD_RETRY);
+        dst.buf[0].fd = fd;
+        dst.buf[0].pos = position;
+        return fuse_buf_copy(&dst, buf, static_cast<fuse_buf_copy_flags>(0));
+      } else if (!fallback) {
+        return result;
+      }
+      if (buf->count == 1 && !(buf->buf[0].flags & FUSE_BUF_IS_FD)) {
+        return write(path, static_cast<const char*>(buf->buf[0].mem), size, offset, info_ptr);
+      }
+      std::vector<char> buffer(size);
+      if (size > 0) {
+        struct fuse_bufvec dst;
+        memset(&dst, 0, sizeof(dst));
+        dst.count = 1;
+        dst.buf[0].size = size;
+        dst.buf[0].mem = &buffer[0];
+        dst.buf[0].fd = -1;
+        ssize_t n = fuse_buf_copy(&dst, buf, static_cast<fuse_buf_copy_flags>(0));
+        if (n < 0) {
+          return n;
+        }
+        size = n;
+      }
+      return write(path, size > 0 ? &buffer[0] : "", size, offset, info_ptr);
+    }
+#endif
 
     // https://linuxjm.osdn.jp/html/LDP_man-pages/man2/flock.2.html
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L557
     int flock(const char* path, struct fuse_file_info* info_ptr, int operation) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      managed_state state(self->manager(dispatch::flock), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "lock")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::lock)) {
         luaX_push(L, path);
         lua_pushvalue(L, info.index());
         luaX_push(L, operation);
@@ -770,11 +1916,15 @@ namespace dromozoa {
     // https://dromozoa.github.io/dromozoa-fuse/fuse-2.9.2/fuse.h.html#L370
     int fallocate(const char* path, int mode, off_t offset, off_t size, struct fuse_file_info* info_ptr) {
       operations* self = static_cast<operations*>(fuse_get_context()->private_data);
-      managed_state state(self->manager());
+      scoped_invalidation invalidation(self, path);
+      managed_state state(self->manager(dispatch::fallocate), path, info_ptr);
       lua_State* L = state.get();
+      if (!L) {
+        return state.result();
+      }
       luaX_top_saver save(L);
-      file_info_t info(L, info_ptr);
-      if (prepare(L, save.get(), "fallocate")) {
+      file_info_t info(L, info_ptr, self->options().use_views);
+      if (prepare(L, save.get(), dispatch::fallocate)) {
         luaX_push(L, path, mode, offset, size);
         lua_pushvalue(L, info.index());
         return call(L, 6);
@@ -783,16 +1933,41 @@ namespace dromozoa {
     }
   }
 
-  operations::operations(state_manager* manager)
+  operations::operations(state_manager* const* managers, const struct options& options)
     : ops_(),
-      manager_(manager) {
-    managed_state state(manager_);
-    lua_State* L = state.get();
-    luaX_top_saver save(L);
+      options_(options),
+      attrs_(options),
+      xattrs_(options.xattr_timeout, options.xattr_cache_size),
+      memos_(options.memo_cache_size),
+      blocks_(options.block_size, options.block_cache_size),
+      disk_(options.disk_cache_dir, options.disk_cache_size),
+      readahead_(options.block_cache_size > 0 ? options.readahead_blocks : 0, options.readahead_threads),
+      writes_(options.write_coalesce_size, options.write_coalesce_age),
+      behind_(options.write_behind_size, options.write_behind_threads),
+      fsyncs_(dispatch::fsync, options.group_commit_window),
+      fsyncdirs_(dispatch::fsyncdir, options.group_commit_window) {
+    std::copy(managers, managers + operation_class::size, managers_);
 
     ops_.init = init;
     ops_.destroy = destroy;
 
+    // a manager shared by several classes is opened only once, since the main
+    // state manager would wait for the state held by this constructor.
+    for (int i = 0; i < operation_class::size; ++i) {
+      if (std::find(managers_, managers_ + i, managers_[i]) == managers_ + i) {
+        managed_state state(managers_[i]);
+        lua_State* L = state.get();
+        if (!L) {
+          throw system_error(-state.result());
+        }
+        luaX_top_saver save(L);
+        resolve(L, managers_[i]);
+      }
+    }
+  }
+
+  // sets the operations whose handlers are run by the target.
+  void operations::resolve(lua_State* L, state_manager* target) {
     DROMOZOA_SET_OPERATION(getattr);
     DROMOZOA_SET_OPERATION(readlink);
     DROMOZOA_SET_OPERATION(mknod);
@@ -829,14 +2004,86 @@ namespace dromozoa {
 #if FUSE_VERSION >= 29
     DROMOZOA_SET_OPERATION(flock);
     DROMOZOA_SET_OPERATION(fallocate);
+    DROMOZOA_SET_OPERATION(read_buf);
+    DROMOZOA_SET_OPERATION(write_buf);
 #endif
+
+    // attached handles are detached and readahead streams are closed on
+    // release even without handlers.
+    if (target->routes_handles() || readahead_.enabled() || writes_.enabled() || behind_.enabled()) {
+      if (manager(dispatch::release) == target) {
+        ops_.release = release;
+      }
+      if (manager(dispatch::releasedir) == target) {
+        ops_.releasedir = releasedir;
+      }
+    }
+
+    // buffered and queued writes are waited for on flush and fsync even
+    // without handlers.
+    if (writes_.enabled() || behind_.enabled()) {
+      if (manager(dispatch::flush) == target) {
+        ops_.flush = flush;
+      }
+      if (manager(dispatch::fsync) == target) {
+        ops_.fsync = fsync;
+      }
+    }
   }
 
   fuse_operations* operations::get() {
     return &ops_;
   }
 
-  state_manager* operations::manager() const {
-    return manager_;
+  state_manager* operations::manager(dispatch::code code) const {
+    return managers_[get_operation_class(code)];
+  }
+
+  state_manager* operations::manager(operation_class::code code) const {
+    return managers_[code];
+  }
+
+  const struct options& operations::options() const {
+    return options_;
+  }
+
+  attr_cache* operations::attrs() {
+    return &attrs_;
+  }
+
+  xattr_cache* operations::xattrs() {
+    return &xattrs_;
+  }
+
+  memo_cache* operations::memos() {
+    return &memos_;
+  }
+
+  block_cache* operations::blocks() {
+    return &blocks_;
+  }
+
+  disk_cache* operations::disk() {
+    return &disk_;
+  }
+
+  readahead_queue* operations::readahead() {
+    return &readahead_;
+  }
+
+  singleflight* operations::flights() {
+    return &flights_;
+  }
+
+  write_coalescer* operations::writes() {
+    return &writes_;
+  }
+
+  write_behind* operations::behind() {
+    return &behind_;
+  }
+
+  group_commit* operations::commits(dispatch::code code) {
+    return code == dispatch::fsyncdir ? &fsyncdirs_ : &fsyncs_;
   }
 }
@@ -0,0 +1,72 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+namespace dromozoa {
+  path_generations::path_generations(size_t max_size)
+    : max_size_(max_size),
+      sequence_(),
+      floor_() {}
+
+  uint64_t path_generations::get() const {
+    return sequence_;
+  }
+
+  // the generation is valid unless the path, or an ancestor with its
+  // descendants, was invalidated after it was taken.
+  bool path_generations::valid(const std::string& path, uint64_t generation) const {
+    if (generation < floor_) {
+      return false;
+    }
+    std::map<std::string, uint64_t>::const_iterator i = paths_.find(path);
+    if (i != paths_.end() && i->second > generation) {
+      return false;
+    }
+    if (!prefixes_.empty()) {
+      for (std::string::size_type p = 0; p < path.size(); p = path.find('/', p + 1)) {
+        std::map<std::string, uint64_t>::const_iterator j = prefixes_.find(path.substr(0, p == 0 ? 1 : p));
+        if (j != prefixes_.end() && j->second > generation) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // when the map is full, it is cleared and every older generation becomes
+  // invalid.
+  void path_generations::invalidate(const std::string& path, bool descendants) {
+    ++sequence_;
+    if (paths_.size() + prefixes_.size() >= max_size_) {
+      paths_.clear();
+      prefixes_.clear();
+      floor_ = sequence_;
+    }
+    paths_[path] = sequence_;
+    if (descendants) {
+      prefixes_[path] = sequence_;
+    }
+  }
+
+  void path_generations::invalidate() {
+    ++sequence_;
+    paths_.clear();
+    prefixes_.clear();
+    floor_ = sequence_;
+  }
+}
@@ -0,0 +1,307 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace dromozoa {
+  namespace {
+    // a stream becomes sequential after this many reads in a row, and its
+    // window starts at this many blocks.
+    const size_t sequential_reads = 2;
+    const size_t initial_window = 2;
+
+    // the number of tracked streams.
+    const size_t max_streams = 1024;
+
+    template <class T_key, class T_request>
+    class key_equal {
+    public:
+      explicit key_equal(const T_key& key) : key_(key) {}
+
+      bool operator()(const T_request& req) const {
+        return req.key == key_;
+      }
+
+    private:
+      T_key key_;
+    };
+  }
+
+  readahead_queue::readahead_queue(size_t max_window, size_t threads)
+    : max_window_(max_window),
+      thread_count_(std::max<size_t>(threads, 1)),
+      max_queue_(thread_count_ * std::max<size_t>(max_window, 1) * 2),
+      self_(),
+      fetch_(),
+      stopping_(),
+      tick_(),
+      streams_count_(),
+      sequential_(),
+      issued_(),
+      fetched_(),
+      skipped_(),
+      failed_(),
+      dropped_(),
+      used_(),
+      wasted_() {}
+
+  readahead_queue::~readahead_queue() {
+    stop();
+  }
+
+  bool readahead_queue::enabled() const {
+    return max_window_ > 0;
+  }
+
+  void readahead_queue::start(operations* self, fetch_type fetch) {
+    if (!enabled() || !threads_.empty()) {
+      return;
+    }
+    self_ = self;
+    fetch_ = fetch;
+    for (size_t i = 0; i < thread_count_; ++i) {
+      threads_.push_back(new thread(start_worker, this));
+    }
+  }
+
+  // queued requests are dropped, and requests in flight are completed.
+  void readahead_queue::stop() {
+    {
+      lock_guard<> lock(mutex_);
+      stopping_ = true;
+      queue_.clear();
+      condition_.notify_all();
+    }
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      threads_[i]->join();
+      delete threads_[i];
+    }
+    threads_.clear();
+  }
+
+  // called after the read was served.  a read which continues the previous
+  // one extends the stream; the window doubles each time the reader passes
+  // half of it, and falls back to nothing on a seek.
+  void readahead_queue::access(const char* path, const struct fuse_file_info* info, uint64_t offset, size_t size, size_t block_size) {
+    if (!enabled() || !path || !info || size == 0) {
+      return;
+    }
+    key_type key(path, info->fh);
+    const struct fuse_context* context = get_context();
+    uint64_t first = offset / block_size;
+    uint64_t last = (offset + size - 1) / block_size;
+
+    lock_guard<> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    std::map<key_type, stream>::iterator i = streams_.find(key);
+    if (i == streams_.end()) {
+      if (streams_.size() >= max_streams) {
+        erase_oldest();
+      }
+      stream& that = streams_[key];
+      that.next = offset + size;
+      that.run = 0;
+      that.window = 0;
+      that.issued = 0;
+      that.end = 0;
+      that.tick = ++tick_;
+      ++streams_count_;
+      return;
+    }
+
+    stream& that = i->second;
+    that.tick = ++tick_;
+    for (uint64_t j = first; j <= last; ++j) {
+      if (that.pending.erase(j)) {
+        ++used_;
+      }
+    }
+    if (offset == that.next) {
+      if (++that.run == sequential_reads) {
+        ++sequential_;
+      }
+    } else {
+      wasted_ += that.pending.size();
+      that.pending.clear();
+      that.run = 0;
+      that.window = 0;
+      that.issued = 0;
+    }
+    that.next = offset + size;
+    if (that.run < sequential_reads) {
+      return;
+    }
+
+    if (that.window == 0) {
+      that.window = std::min(initial_window, max_window_);
+    } else if (last + that.window / 2 >= that.issued) {
+      that.window = std::min(that.window * 2, max_window_);
+    }
+    uint64_t from = std::max(that.issued, last + 1);
+    uint64_t to = last + 1 + that.window;
+    if (that.end > 0) {
+      to = std::min(to, that.end);
+    }
+    for (uint64_t j = from; j < to; ++j) {
+      if (queue_.size() >= max_queue_) {
+        ++dropped_;
+        continue;
+      }
+      request req;
+      req.key = key;
+      req.info = *info;
+      req.index = j;
+      req.has_context = context != 0;
+      if (context) {
+        req.context = *context;
+      }
+      queue_.push_back(req);
+      ++issued_;
+    }
+    if (from < to) {
+      that.issued = to;
+      condition_.notify_all();
+    }
+  }
+
+  // prefetched blocks which were never read are counted as wasted.  the
+  // queued requests of the handle are dropped and the running ones are
+  // waited for, so that no read with the handle is made after release,
+  // when the number may already belong to another file.
+  void readahead_queue::close(const char* path, uint64_t fh) {
+    if (!enabled() || !path) {
+      return;
+    }
+    key_type key(path, fh);
+    lock_guard<> lock(mutex_);
+    std::deque<request>::iterator end = std::remove_if(queue_.begin(), queue_.end(), key_equal<key_type, request>(key));
+    dropped_ += queue_.end() - end;
+    queue_.erase(end, queue_.end());
+    while (running_.find(key) != running_.end()) {
+      condition_.wait(lock);
+    }
+    std::map<key_type, stream>::iterator i = streams_.find(key);
+    if (i != streams_.end()) {
+      wasted_ += i->second.pending.size();
+      streams_.erase(i);
+    }
+  }
+
+  void readahead_queue::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "threads", threads_.size());
+    luaX_set_field(L, -1, "streams", streams_.size());
+    luaX_set_field(L, -1, "queued", queue_.size());
+    size_t pending = 0;
+    size_t max_window = 0;
+    for (std::map<key_type, stream>::const_iterator i = streams_.begin(); i != streams_.end(); ++i) {
+      pending += i->second.pending.size();
+      max_window = std::max(max_window, i->second.window);
+    }
+    luaX_set_field(L, -1, "pending", pending);
+    luaX_set_field(L, -1, "window", max_window);
+    luaX_set_field(L, -1, "opened_streams", streams_count_);
+    luaX_set_field(L, -1, "sequential_streams", sequential_);
+    luaX_set_field(L, -1, "issued", issued_);
+    luaX_set_field(L, -1, "fetched", fetched_);
+    luaX_set_field(L, -1, "skipped", skipped_);
+    luaX_set_field(L, -1, "failed", failed_);
+    luaX_set_field(L, -1, "dropped", dropped_);
+    luaX_set_field(L, -1, "used", used_);
+    luaX_set_field(L, -1, "wasted", wasted_);
+  }
+
+  void* readahead_queue::start_worker(void* self) {
+    static_cast<readahead_queue*>(self)->work();
+    return 0;
+  }
+
+  void readahead_queue::work() {
+    while (true) {
+      request req;
+      {
+        lock_guard<> lock(mutex_);
+        while (!stopping_ && queue_.empty()) {
+          condition_.wait(lock);
+        }
+        if (stopping_) {
+          return;
+        }
+        req = queue_.front();
+        queue_.pop_front();
+        ++running_[req.key];
+      }
+
+      // close waits until the block is read.  the handler sees the context
+      // of the read which issued the request.
+      int result = 0;
+      {
+        scoped_context context(req.has_context ? &req.context : 0);
+        result = fetch_(self_, req.key.first.c_str(), req.index, &req.info);
+      }
+
+      lock_guard<> lock(mutex_);
+      std::map<key_type, size_t>::iterator r = running_.find(req.key);
+      if (--r->second == 0) {
+        running_.erase(r);
+        condition_.notify_all();
+      }
+      std::map<key_type, stream>::iterator i = streams_.find(req.key);
+      if (result < 0) {
+        ++failed_;
+      } else if (result == fetch_cached) {
+        ++skipped_;
+      } else {
+        ++fetched_;
+        if (i != streams_.end() && req.index < i->second.issued) {
+          i->second.pending.insert(req.index);
+        } else {
+          ++wasted_;
+        }
+      }
+      // a short or failed block ends the stream.
+      if (i != streams_.end() && (result < 0 || result == fetch_short)) {
+        stream& that = i->second;
+        if (that.end == 0 || that.end > req.index + 1) {
+          that.end = req.index + 1;
+        }
+      }
+    }
+  }
+
+  // called with mutex_ locked.
+  void readahead_queue::erase_oldest() {
+    std::map<key_type, stream>::iterator oldest = streams_.begin();
+    for (std::map<key_type, stream>::iterator i = streams_.begin(); i != streams_.end(); ++i) {
+      if (i->second.tick < oldest->second.tick) {
+        oldest = i;
+      }
+    }
+    if (oldest != streams_.end()) {
+      wasted_ += oldest->second.pending.size();
+      streams_.erase(oldest);
+    }
+  }
+}
@@ -0,0 +1,110 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+namespace dromozoa {
+  singleflight::singleflight() : leaders_(), followers_(), detached_() {}
+
+  // returns the call which the caller leads and must finish with done.
+  // otherwise waits for the call in flight, takes its result and returns
+  // null.
+  singleflight::call* singleflight::join(const std::string& key, int* result, std::string* data) {
+    lock_guard<> lock(mutex_);
+    std::map<std::string, call*>::iterator i = calls_.find(key);
+    if (i == calls_.end()) {
+      call* that = new call();
+      that->key = key;
+      that->result = 0;
+      that->done = false;
+      that->detached = false;
+      that->waiters = 0;
+      calls_.insert(std::make_pair(key, that));
+      ++leaders_;
+      return that;
+    }
+    call* that = i->second;
+    ++that->waiters;
+    ++followers_;
+    while (!that->done) {
+      condition_.wait(lock);
+    }
+    *result = that->result;
+    *data = that->data;
+    if (--that->waiters == 0) {
+      delete that;
+    }
+    return 0;
+  }
+
+  // later calls with the key start a new flight.
+  void singleflight::done(call* that, int result, const std::string& data) {
+    lock_guard<> lock(mutex_);
+    if (!that->detached) {
+      calls_.erase(that->key);
+    }
+    if (that->waiters == 0) {
+      delete that;
+      return;
+    }
+    that->result = result;
+    that->data = data;
+    that->done = true;
+    condition_.notify_all();
+  }
+
+  // the calls of the path, and of its descendants if requested, may have
+  // started before it was modified.  they are detached, so that later calls
+  // start a new flight, while their current waiters still take their
+  // results.
+  void singleflight::invalidate(const char* path, bool descendants) {
+    std::string prefix(path);
+    lock_guard<> lock(mutex_);
+    std::map<std::string, call*>::iterator i = calls_.lower_bound(prefix);
+    while (i != calls_.end() && i->first.compare(0, prefix.size(), prefix) == 0) {
+      char c = i->first[prefix.size()];
+      if (c == '\0' || (descendants && (c == '/' || prefix == "/"))) {
+        detach(i++);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  void singleflight::invalidate() {
+    lock_guard<> lock(mutex_);
+    while (!calls_.empty()) {
+      detach(calls_.begin());
+    }
+  }
+
+  void singleflight::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "in_flight", calls_.size());
+    luaX_set_field(L, -1, "leaders", leaders_);
+    luaX_set_field(L, -1, "followers", followers_);
+    luaX_set_field(L, -1, "detached", detached_);
+  }
+
+  // called with mutex_ locked.
+  void singleflight::detach(std::map<std::string, call*>::iterator i) {
+    i->second->detached = true;
+    calls_.erase(i);
+    ++detached_;
+  }
+}
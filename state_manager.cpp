@@ -1,4 +1,4 @@
-// Copyright (C) 2019 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2019,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -22,10 +22,36 @@ namespace dromozoa {
     void impl_gc(lua_State* L) {
       check_state_manager(L, 1)->~state_manager();
     }
+
+    void impl_stats(lua_State* L) {
+      check_state_manager(L, 1)->stats(L);
+    }
   }
 
   state_manager::~state_manager() {}
 
+  // pushes a table of counters.
+  void state_manager::stats(lua_State* L) {
+    lua_newtable(L);
+  }
+
+  lua_State* state_manager::open_route(const char*, const struct fuse_file_info*) {
+    return open();
+  }
+
+  void state_manager::attach_handle(lua_State*, uint64_t) {}
+
+  void state_manager::detach_handle(uint64_t) {}
+
+  bool state_manager::routes_handles() const {
+    return false;
+  }
+
+  // true if the operation would be routed to the state.
+  bool state_manager::shares_route(lua_State*, const char*, const struct fuse_file_info*) {
+    return true;
+  }
+
   state_manager* check_state_manager(lua_State* L, int arg) {
     return luaX_check_udata<state_manager>(L, arg, "dromozoa.fuse.state_manager");
   }
@@ -42,6 +68,8 @@ namespace dromozoa {
       luaX_set_field(L, -1, "__gc", impl_gc);
       lua_pop(L, 1);
 
+      luaX_set_field(L, -1, "stats", impl_stats);
+
       initialize_state_manager_main(L);
       initialize_state_manager_pool(L);
     }
@@ -1,4 +1,4 @@
-// Copyright (C) 2019 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2019,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -61,6 +61,7 @@ namespace dromozoa {
       int reference = luaL_ref(L, LUA_REGISTRYINDEX);
       lua_pushvalue(L, -1);
       lua_xmove(L, state, 1);
+      new_dispatch(state, -1);
       luaX_new<state_manager_main>(L, state, reference);
       luaX_set_metatable(L, "dromozoa.fuse.state_manager");
     }
@@ -1,4 +1,4 @@
-// Copyright (C) 2019 Tomoyuki Fujimori <moyu@dromozoa.com>
+// Copyright (C) 2019,2026 Tomoyuki Fujimori <moyu@dromozoa.com>
 //
 // This file is part of dromozoa-fuse.
 //
@@ -17,16 +17,26 @@
 
 #include "common.hpp"
 
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
 extern "C" {
 #include <lualib.h>
 }
 
+#include <algorithm>
 #include <list>
+#include <map>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 #include <dromozoa/bind/condition_variable.hpp>
 #include <dromozoa/bind/mutex.hpp>
+#include <dromozoa/bind/scoped_ptr.hpp>
+#include <dromozoa/bind/system_error.hpp>
+#include <dromozoa/bind/thread.hpp>
 
 namespace dromozoa {
   namespace {
@@ -56,13 +66,197 @@ namespace dromozoa {
       scoped_state& operator=(const scoped_state&);
     };
 
-    lua_State* construct(const std::string& chunk, const std::string& name) {
+    struct pool_options {
+      // keep a sticky state for each thread.
+      unsigned int affinity;
+      // fail with EAGAIN after waiting this many seconds for a state; zero
+      // means no limit.
+      double wait_timeout;
+      // fail with EBUSY when this many threads are already waiting; zero
+      // means no limit.
+      size_t max_waiters;
+      // keep this many idle states ready on a maintenance thread, which then
+      // constructs every new state off the request path.
+      size_t min_spare_states;
+      // let the maintenance thread close states which stayed idle for this
+      // many seconds, instead of closing states above max_idle_states on the
+      // spot; zero means no reaping.
+      double idle_timeout;
+      // seconds between maintenance rounds.
+      double maintenance_interval;
+      // run the operations on a file handle by the state which opened it.
+      // handles must be unique; a handle of zero is routed as if there were
+      // none.
+      unsigned int sticky_handles;
+      // run the operations on a path by the state chosen by its hash.
+      unsigned int hash_paths;
+      // construct start_states on this many threads.
+      size_t bootstrap_threads;
+      // return from the constructor when this many of start_states are
+      // ready and construct the rest in the background; zero means all.
+      size_t ready_states;
+      // open only the standard libraries named in libs instead of all.
+      bool select_libs;
+      std::vector<std::string> libs;
+    };
+
+    struct lib {
+      const char* name;
+      lua_CFunction open;
+    };
+
+    const lib libs[] = {
+      { "_G", luaopen_base },
+      { "base", luaopen_base },
+      { LUA_LOADLIBNAME, luaopen_package },
+#if LUA_VERSION_NUM+0 >= 502
+      { LUA_COLIBNAME, luaopen_coroutine },
+#endif
+      { LUA_TABLIBNAME, luaopen_table },
+      { LUA_IOLIBNAME, luaopen_io },
+      { LUA_OSLIBNAME, luaopen_os },
+      { LUA_STRLIBNAME, luaopen_string },
+      { LUA_MATHLIBNAME, luaopen_math },
+#if LUA_VERSION_NUM+0 >= 503
+      { LUA_UTF8LIBNAME, luaopen_utf8 },
+#endif
+#if LUA_VERSION_NUM+0 == 502 || defined(LUA_COMPAT_BITLIB)
+      { LUA_BITLIBNAME, luaopen_bit32 },
+#endif
+      { LUA_DBLIBNAME, luaopen_debug },
+      { 0, 0 },
+    };
+
+    const lib* find_lib(const char* name) {
+      for (const lib* i = libs; i->name; ++i) {
+        if (strcmp(i->name, name) == 0) {
+          return i;
+        }
+      }
+      return 0;
+    }
+
+    void open_lib(lua_State* L, const lib* that) {
+#if LUA_VERSION_NUM+0 >= 502
+      luaL_requiref(L, that->open == luaopen_base ? "_G" : that->name, that->open, 1);
+      lua_pop(L, 1);
+#else
+      lua_pushcfunction(L, that->open);
+      lua_pushstring(L, that->open == luaopen_base ? "" : that->name);
+      lua_call(L, 1, 0);
+#endif
+    }
+
+    double opt_number_field(lua_State* L, int index, const char* key, double d) {
+      luaX_get_field(L, index, key);
+      double result = d;
+      if (lua_isnumber(L, -1)) {
+        result = lua_tonumber(L, -1);
+      } else if (!lua_isnil(L, -1)) {
+        luaX_field_error(L, key, "not a number");
+      }
+      lua_pop(L, 1);
+      return result;
+    }
+
+    void check_pool_options(lua_State* L, int index, pool_options* that) {
+      if (lua_istable(L, index)) {
+        that->affinity = luaX_opt_integer_field(L, index, "affinity", that->affinity);
+        that->wait_timeout = opt_number_field(L, index, "wait_timeout", that->wait_timeout);
+        that->max_waiters = luaX_opt_integer_field(L, index, "max_waiters", that->max_waiters);
+        that->min_spare_states = luaX_opt_integer_field(L, index, "min_spare_states", that->min_spare_states);
+        that->idle_timeout = opt_number_field(L, index, "idle_timeout", that->idle_timeout);
+        that->maintenance_interval = opt_number_field(L, index, "maintenance_interval", that->maintenance_interval);
+        that->sticky_handles = luaX_opt_integer_field(L, index, "sticky_handles", that->sticky_handles);
+        that->hash_paths = luaX_opt_integer_field(L, index, "hash_paths", that->hash_paths);
+        that->bootstrap_threads = luaX_opt_integer_field(L, index, "bootstrap_threads", that->bootstrap_threads);
+        that->ready_states = luaX_opt_integer_field(L, index, "ready_states", that->ready_states);
+        luaX_get_field(L, index, "libs");
+        if (lua_istable(L, -1)) {
+          that->select_libs = true;
+          for (int i = 1; ; ++i) {
+            luaX_get_field(L, -1, i);
+            if (const char* p = lua_tostring(L, -1)) {
+              if (!find_lib(p)) {
+                luaX_field_error(L, "libs", "contains an unknown library");
+              }
+              that->libs.push_back(p);
+              lua_pop(L, 1);
+            } else {
+              lua_pop(L, 1);
+              break;
+            }
+          }
+        } else if (!lua_isnil(L, -1)) {
+          luaX_field_error(L, "libs", "not a table");
+        }
+        lua_pop(L, 1);
+      } else if (!lua_isnoneornil(L, index)) {
+        luaX_throw_failure("table expected");
+      }
+    }
+
+    bool use_routing(const pool_options& options) {
+      return options.sticky_handles || options.hash_paths;
+    }
+
+    // FNV-1a
+    size_t hash_path(const char* path) {
+      uint32_t hash = 2166136261U;
+      for (const unsigned char* p = reinterpret_cast<const unsigned char*>(path); *p; ++p) {
+        hash ^= *p;
+        hash *= 16777619U;
+      }
+      return hash;
+    }
+
+    bool use_maintenance(const pool_options& options) {
+      return options.min_spare_states > 0 || options.idle_timeout > 0;
+    }
+
+    int write_chunk(lua_State*, const void* data, size_t size, void* buffer) {
+      static_cast<std::string*>(buffer)->append(static_cast<const char*>(data), size);
+      return 0;
+    }
+
+    // the chunk is compiled once and every state loads the bytecode.
+    std::string compile(const std::string& chunk, const std::string& name) {
       scoped_state state(luaL_newstate());
       if (lua_State* L = state.get()) {
-        luaL_openlibs(L);
-        int result = luaL_loadbuffer(L, chunk.data(), chunk.size(), name.c_str());
+        if (luaL_loadbuffer(L, chunk.data(), chunk.size(), name.c_str()) != 0) {
+          throw std::runtime_error(lua_tostring(L, -1));
+        }
+        std::string bytecode;
+#if LUA_VERSION_NUM+0 >= 503
+        int result = lua_dump(L, write_chunk, &bytecode, 0);
+#else
+        int result = lua_dump(L, write_chunk, &bytecode);
+#endif
+        if (result != 0) {
+          std::ostringstream out;
+          out << "could not lua_dump: error number " << result;
+          throw std::runtime_error(out.str());
+        }
+        return bytecode;
+      } else {
+        throw std::runtime_error("could not luaL_newstate");
+      }
+    }
+
+    lua_State* construct(const std::string& bytecode, const std::string& name, const pool_options& options) {
+      scoped_state state(luaL_newstate());
+      if (lua_State* L = state.get()) {
+        if (options.select_libs) {
+          for (std::vector<std::string>::const_iterator i = options.libs.begin(); i != options.libs.end(); ++i) {
+            open_lib(L, find_lib(i->c_str()));
+          }
+        } else {
+          luaL_openlibs(L);
+        }
+        int result = luaL_loadbuffer(L, bytecode.data(), bytecode.size(), name.c_str());
         if (result == 0) {
           if (lua_pcall(L, 0, 1, 0) == 0) {
+            new_dispatch(L, -1);
             return state.release();
           } else {
             throw std::runtime_error(lua_tostring(L, -1));
@@ -77,77 +271,883 @@ namespace dromozoa {
       }
     }
 
+    // counters of the slow path, guarded by the mutex of the pool.
+    struct pool_stats {
+      size_t waits;
+      double wait_time;
+      double max_wait_time;
+      size_t peak_waiters;
+      size_t timeouts;
+      size_t rejections;
+      size_t spares;
+      size_t reaped;
+      size_t sticky_routes;
+      size_t hashed_routes;
+      size_t route_waits;
+    };
+
+    // with routing, each of max_states lanes runs one state at a time and
+    // the operations routed to a lane wait for it instead of taking any
+    // idle state.
+    struct lane {
+      lua_State* state;
+      bool busy;
+      size_t count;
+    };
+
+    class state_manager_pool;
+
+    // a thread-local slot holds the sticky state of the thread while it is
+    // not in use.  the owner takes and parks the state without locking, and
+    // waiters may steal the parked state when the pool is exhausted.
+    struct slot {
+      explicit slot(state_manager_pool* self) : self(self), state() {}
+      state_manager_pool* self;
+      lua_State* volatile state;
+    };
+
+    void destroy_slot(void*);
+
+    // a bounded lock-free stack of idle states.  nodes are preallocated and
+    // linked by index; the heads carry a tag which is incremented on every
+    // update to avoid the ABA problem.
+    class idle_stack {
+    public:
+      explicit idle_stack(size_t capacity)
+        : nodes_(capacity),
+          head_(),
+          free_(capacity),
+          size_(),
+          low_() {
+        for (size_t i = 0; i < capacity; ++i) {
+          nodes_[i].next = i;
+        }
+      }
+
+      // the size is counted before the node is linked, so that a concurrent
+      // pop never takes it below zero.
+      bool push(lua_State* state) {
+        if (uint32_t link = pop_link(&free_)) {
+          nodes_[link - 1].state = state;
+          __sync_add_and_fetch(&size_, 1);
+          push_link(&head_, link);
+          return true;
+        }
+        return false;
+      }
+
+      lua_State* pop() {
+        if (uint32_t link = pop_link(&head_)) {
+          lua_State* state = nodes_[link - 1].state;
+          push_link(&free_, link);
+          size_t size = __sync_sub_and_fetch(&size_, 1);
+          while (true) {
+            size_t low = low_;
+            if (low <= size || __sync_bool_compare_and_swap(&low_, low, size)) {
+              break;
+            }
+          }
+          return state;
+        }
+        return 0;
+      }
+
+      size_t size() const {
+        return size_;
+      }
+
+      // returns the smallest size since the last call.  that many states
+      // have not been popped in the meantime.
+      size_t reset_low() {
+        return __sync_lock_test_and_set(&low_, size_);
+      }
+
+      // removes up to n states from the bottom, where the coldest states are.
+      // the chain is detached, cut, and its top is pushed back at once, so
+      // that the stack looks empty only for the walk.
+      size_t pop_bottom(size_t n, std::vector<lua_State*>* states) {
+        if (n == 0) {
+          return 0;
+        }
+        uint32_t top = 0;
+        while (true) {
+          uint64_t head = head_;
+          top = static_cast<uint32_t>(head);
+          if (top == 0) {
+            return 0;
+          }
+          uint64_t tag = (head >> 32) + 1;
+          if (__sync_bool_compare_and_swap(&head_, head, tag << 32)) {
+            break;
+          }
+        }
+        std::vector<uint32_t> links;
+        for (uint32_t link = top; link != 0; link = nodes_[link - 1].next) {
+          links.push_back(link);
+        }
+        size_t keep = links.size() > n ? links.size() - n : 0;
+        if (keep > 0) {
+          uint32_t tail = links[keep - 1];
+          while (true) {
+            uint64_t head = head_;
+            nodes_[tail - 1].next = static_cast<uint32_t>(head);
+            uint64_t tag = (head >> 32) + 1;
+            if (__sync_bool_compare_and_swap(&head_, head, tag << 32 | top)) {
+              break;
+            }
+          }
+        }
+        for (size_t i = keep; i < links.size(); ++i) {
+          states->push_back(nodes_[links[i] - 1].state);
+          push_link(&free_, links[i]);
+        }
+        size_t count = links.size() - keep;
+        __sync_sub_and_fetch(&size_, count);
+        return count;
+      }
+
+    private:
+      struct node {
+        lua_State* state;
+        uint32_t next;
+      };
+
+      std::vector<node> nodes_;
+      volatile uint64_t head_;
+      volatile uint64_t free_;
+      volatile size_t size_;
+      volatile size_t low_;
+
+      uint32_t pop_link(volatile uint64_t* top) {
+        while (true) {
+          uint64_t head = *top;
+          uint32_t link = static_cast<uint32_t>(head);
+          if (link == 0) {
+            return 0;
+          }
+          uint64_t tag = (head >> 32) + 1;
+          if (__sync_bool_compare_and_swap(top, head, tag << 32 | nodes_[link - 1].next)) {
+            return link;
+          }
+        }
+      }
+
+      void push_link(volatile uint64_t* top, uint32_t link) {
+        while (true) {
+          uint64_t head = *top;
+          nodes_[link - 1].next = static_cast<uint32_t>(head);
+          uint64_t tag = (head >> 32) + 1;
+          if (__sync_bool_compare_and_swap(top, head, tag << 32 | link)) {
+            return;
+          }
+        }
+      }
+
+      idle_stack(const idle_stack&);
+      idle_stack& operator=(const idle_stack&);
+    };
+
     class state_manager_pool : public state_manager {
     public:
-      state_manager_pool(size_t start_states, size_t max_states, size_t max_idle_states, const std::string& chunk, const std::string& name)
+      state_manager_pool(size_t start_states, size_t max_states, size_t max_idle_states, const std::string& chunk, const std::string& name, const pool_options& options)
         : max_states_(max_states),
           max_idle_states_(max_idle_states),
-          chunk_(chunk),
+          chunk_(compile(chunk, name)),
           name_(name),
-          active_states_() {
-        for (size_t i = 0; i < start_states; ++i) {
-          scoped_state state(construct(chunk_, name_));
-          idle_states_.push_back(state.get());
-          state.release();
+          options_(options),
+          active_states_(),
+          idle_states_(std::max(std::max(start_states, max_idle_states), options.idle_timeout > 0 ? max_states : 0)),
+          waiters_(),
+          stats_(),
+          stopping_(),
+          wakeup_(),
+          start_states_(start_states),
+          bootstrap_next_(),
+          bootstrap_ready_(),
+          bootstrap_done_(),
+          bootstrap_cancel_(),
+          bootstrap_live_() {
+        if (use_routing(options_)) {
+          if (max_states_ == 0) {
+            throw std::runtime_error("routing requires max_states");
+          }
+          lane zero = {};
+          lanes_.resize(max_states_, zero);
+        }
+        if (options_.affinity) {
+          if (int result = pthread_key_create(&key_, destroy_slot)) {
+            throw system_error(result);
+          }
+        }
+        try {
+          bootstrap();
+          if (use_maintenance(options_)) {
+            maintenance_thread_.reset(new thread(start_maintenance, this));
+          }
+        } catch (...) {
+          join_bootstrap();
+          while (lua_State* L = idle_states_.pop()) {
+            lua_close(L);
+          }
+          if (options_.affinity) {
+            pthread_key_delete(key_);
+          }
+          throw;
         }
       }
 
       ~state_manager_pool() {
-        while (!idle_states_.empty()) {
-          scoped_state state(idle_states_.front());
-          idle_states_.pop_front();
+        join_bootstrap();
+        if (thread* maintenance_thread = maintenance_thread_.get()) {
+          {
+            lock_guard<> lock(maintenance_mutex_);
+            stopping_ = true;
+            maintenance_condition_.notify_one();
+          }
+          maintenance_thread->join();
+        }
+        if (options_.affinity) {
+          pthread_key_delete(key_);
+          for (std::list<slot*>::iterator i = slots_.begin(); i != slots_.end(); ++i) {
+            scoped_state state((*i)->state);
+            delete *i;
+          }
+        }
+        for (std::vector<lane>::iterator i = lanes_.begin(); i != lanes_.end(); ++i) {
+          if (i->state) {
+            lua_close(i->state);
+          }
+        }
+        while (lua_State* L = idle_states_.pop()) {
+          lua_close(L);
         }
       }
 
       lua_State* open() {
+        if (!lanes_.empty()) {
+          return open_route(0, 0);
+        }
+        if (options_.affinity) {
+          if (lua_State* L = __sync_lock_test_and_set(&get_slot()->state, 0)) {
+            return L;
+          }
+        }
+        if (lua_State* L = idle_states_.pop()) {
+          __sync_add_and_fetch(&active_states_, 1);
+          if (idle_states_.size() < options_.min_spare_states) {
+            wake_maintenance();
+          }
+          return L;
+        }
+        // with spares, new states are constructed by the maintenance thread.
+        bool maintenance = options_.min_spare_states > 0;
+        if (!maintenance && reserve()) {
+          return construct_reserved();
+        }
+
+        // the pool is exhausted.  the waiter is counted before the pool is
+        // checked again, so that close never misses it.
         {
           lock_guard<> lock(mutex_);
-          while (idle_states_.empty() && active_states_ >= max_states_) {
-            condition_.wait(lock);
+          if (options_.max_waiters > 0 && waiters_ >= options_.max_waiters) {
+            ++stats_.rejections;
+            throw system_error(EBUSY);
           }
-          ++active_states_;
-          if (!idle_states_.empty()) {
-            scoped_state state(idle_states_.front());
-            idle_states_.pop_front();
-            return state.release();
+          size_t waiters = __sync_add_and_fetch(&waiters_, 1);
+          stats_.peak_waiters = std::max(stats_.peak_waiters, waiters);
+          double start = 0;
+          while (true) {
+            lua_State* L = idle_states_.pop();
+            if (L) {
+              __sync_add_and_fetch(&active_states_, 1);
+            } else if (options_.affinity) {
+              L = steal();
+            }
+            bool reserved = !L && !maintenance && reserve();
+            if (L || reserved) {
+              __sync_sub_and_fetch(&waiters_, 1);
+              if (start > 0) {
+                double t = now() - start;
+                stats_.wait_time += t;
+                stats_.max_wait_time = std::max(stats_.max_wait_time, t);
+              }
+              if (L) {
+                return L;
+              }
+              break;
+            }
+            if (start == 0) {
+              start = now();
+              ++stats_.waits;
+            }
+            if (maintenance) {
+              wake_maintenance();
+            }
+            if (!wait(lock, start)) {
+              __sync_sub_and_fetch(&waiters_, 1);
+              double t = now() - start;
+              stats_.wait_time += t;
+              stats_.max_wait_time = std::max(stats_.max_wait_time, t);
+              ++stats_.timeouts;
+              throw system_error(EAGAIN);
+            }
           }
         }
-        return construct(chunk_, name_);
+        return construct_reserved();
       }
 
       void close(lua_State* L) {
-        scoped_state state(L);
+        if (!lanes_.empty()) {
+          lock_guard<> lock(mutex_);
+          size_t index = find_lane(L);
+          if (index < lanes_.size()) {
+            lanes_[index].busy = false;
+            condition_.notify_all();
+          } else {
+            DROMOZOA_UNEXPECTED("state not found in lanes");
+          }
+          return;
+        }
+        if (options_.affinity) {
+          slot* s = get_slot();
+          if (__sync_bool_compare_and_swap(&s->state, 0, L)) {
+            if (__sync_add_and_fetch(&waiters_, 0) == 0) {
+              return;
+            }
+            // hand the state over to a waiter unless it has been stolen.
+            if (!__sync_bool_compare_and_swap(&s->state, L, 0)) {
+              return;
+            }
+          }
+        }
+        release(L);
+      }
+
+      lua_State* open_route(const char* path, const struct fuse_file_info* info) {
+        if (lanes_.empty()) {
+          return open();
+        }
+        size_t n = lanes_.size();
+        size_t index = n;
         {
           lock_guard<> lock(mutex_);
-          --active_states_;
-          if (idle_states_.size() < max_idle_states_) {
-            idle_states_.push_back(state.get());
-            state.release();
+          size_t route = find_route(path, info, true);
+          double start = 0;
+          while (true) {
+            index = route < n ? route : find_free_lane();
+            if (index < n && !lanes_[index].busy) {
+              break;
+            }
+            // the waiter is admitted and counted as in open.
+            if (start == 0) {
+              if (options_.max_waiters > 0 && waiters_ >= options_.max_waiters) {
+                ++stats_.rejections;
+                throw system_error(EBUSY);
+              }
+              size_t waiters = __sync_add_and_fetch(&waiters_, 1);
+              stats_.peak_waiters = std::max(stats_.peak_waiters, waiters);
+              start = now();
+              ++stats_.waits;
+              if (route < n) {
+                ++stats_.route_waits;
+              }
+            }
+            if (!wait(lock, start)) {
+              __sync_sub_and_fetch(&waiters_, 1);
+              double t = now() - start;
+              stats_.wait_time += t;
+              stats_.max_wait_time = std::max(stats_.max_wait_time, t);
+              ++stats_.timeouts;
+              throw system_error(EAGAIN);
+            }
+          }
+          if (start > 0) {
+            __sync_sub_and_fetch(&waiters_, 1);
+            double t = now() - start;
+            stats_.wait_time += t;
+            stats_.max_wait_time = std::max(stats_.max_wait_time, t);
+          }
+          lane& that = lanes_[index];
+          that.busy = true;
+          ++that.count;
+          if (that.state) {
+            return that.state;
           }
         }
+
+        // the lane is held, so its state is constructed without the lock.
+        lua_State* L = idle_states_.pop();
+        try {
+          if (!L) {
+            L = construct(chunk_, name_, options_);
+          }
+        } catch (...) {
+          lock_guard<> lock(mutex_);
+          lanes_[index].busy = false;
+          condition_.notify_all();
+          throw;
+        }
+        lock_guard<> lock(mutex_);
+        lanes_[index].state = L;
+        lane_indices_[L] = index;
+        return L;
+      }
+
+      // a handle of zero is not routed, since a handler which never sets the
+      // number leaves it zero for every open file.
+      void attach_handle(lua_State* L, uint64_t fh) {
+        if (options_.sticky_handles && !lanes_.empty() && fh != 0) {
+          lock_guard<> lock(mutex_);
+          size_t index = find_lane(L);
+          if (index < lanes_.size()) {
+            handles_[fh] = index;
+          }
+        }
+      }
+
+      void detach_handle(uint64_t fh) {
+        if (options_.sticky_handles && !lanes_.empty() && fh != 0) {
+          lock_guard<> lock(mutex_);
+          handles_.erase(fh);
+        }
+      }
+
+      bool routes_handles() const {
+        return options_.sticky_handles && !lanes_.empty();
+      }
+
+      bool shares_route(lua_State* L, const char* path, const struct fuse_file_info* info) {
+        if (lanes_.empty()) {
+          return true;
+        }
+        lock_guard<> lock(mutex_);
+        size_t route = find_route(path, info, false);
+        return route == lanes_.size() || lanes_[route].state == L;
+      }
+
+      void stats(lua_State* L) {
+        size_t active_states = active_states_;
+        size_t idle_states = idle_states_.size();
+        size_t waiters = waiters_;
+        pool_stats stats = {};
+        {
+          lock_guard<> lock(mutex_);
+          stats = stats_;
+        }
+        lua_newtable(L);
+        luaX_set_field(L, -1, "active_states", active_states);
+        luaX_set_field(L, -1, "idle_states", idle_states);
+        luaX_set_field(L, -1, "max_states", max_states_);
+        luaX_set_field(L, -1, "waiters", waiters);
+        luaX_set_field(L, -1, "peak_waiters", stats.peak_waiters);
+        luaX_set_field(L, -1, "waits", stats.waits);
+        luaX_set_field(L, -1, "wait_time", stats.wait_time);
+        luaX_set_field(L, -1, "max_wait_time", stats.max_wait_time);
+        luaX_set_field(L, -1, "timeouts", stats.timeouts);
+        luaX_set_field(L, -1, "rejections", stats.rejections);
+        luaX_set_field(L, -1, "spares", stats.spares);
+        luaX_set_field(L, -1, "reaped", stats.reaped);
+        if (!lanes_.empty()) {
+          stats_lanes(L, stats);
+        }
+        lock_guard<> lock(bootstrap_mutex_);
+        luaX_set_field(L, -1, "bootstrap_failures", bootstrap_errors_.size());
+      }
+
+      // the imbalance is the ratio of the busiest lane to the mean of the
+      // lanes, so that 1 means the operations are spread evenly.
+      void stats_lanes(lua_State* L, const pool_stats& stats) {
+        std::vector<size_t> counts;
+        size_t handles = 0;
+        {
+          lock_guard<> lock(mutex_);
+          for (std::vector<lane>::const_iterator i = lanes_.begin(); i != lanes_.end(); ++i) {
+            counts.push_back(i->count);
+          }
+          handles = handles_.size();
+        }
+        size_t total = 0;
+        size_t max_count = 0;
+        lua_createtable(L, counts.size(), 0);
+        for (size_t i = 0; i < counts.size(); ++i) {
+          luaX_set_field(L, -1, i + 1, counts[i]);
+          total += counts[i];
+          max_count = std::max(max_count, counts[i]);
+        }
+        luaX_set_field(L, -2, "lanes");
+        luaX_set_field(L, -1, "handles", handles);
+        luaX_set_field(L, -1, "sticky_routes", stats.sticky_routes);
+        luaX_set_field(L, -1, "hashed_routes", stats.hashed_routes);
+        luaX_set_field(L, -1, "route_waits", stats.route_waits);
+        luaX_set_field(L, -1, "imbalance", total > 0 ? static_cast<double>(max_count) * counts.size() / total : 0.0);
+      }
+
+      void release_slot(slot* s) {
+        {
+          lock_guard<> lock(mutex_);
+          slots_.remove(s);
+        }
+        if (lua_State* L = __sync_lock_test_and_set(&s->state, 0)) {
+          release(L);
+        }
+        delete s;
       }
 
     private:
       size_t max_states_;
       size_t max_idle_states_;
-      std::string chunk_;
+      std::string chunk_; // bytecode
       std::string name_;
+      pool_options options_;
       mutex mutex_;
       condition_variable condition_;
-      size_t active_states_;
-      std::list<lua_State*> idle_states_;
+      volatile size_t active_states_;
+      idle_stack idle_states_;
+      pthread_key_t key_;
+      std::list<slot*> slots_;
+      volatile size_t waiters_;
+      pool_stats stats_;
+      scoped_ptr<thread> maintenance_thread_;
+      mutex maintenance_mutex_;
+      condition_variable maintenance_condition_;
+      bool stopping_;
+      bool wakeup_;
+
+      size_t start_states_;
+      volatile size_t bootstrap_next_;
+      std::vector<thread*> bootstrap_threads_;
+      mutex bootstrap_mutex_;
+      condition_variable bootstrap_condition_;
+      size_t bootstrap_ready_;
+      size_t bootstrap_done_;
+      std::map<size_t, std::string> bootstrap_errors_;
+      volatile bool bootstrap_cancel_;
+      bool bootstrap_live_;
+
+      std::vector<lane> lanes_;
+      std::map<lua_State*, size_t> lane_indices_;
+      std::map<uint64_t, size_t> handles_;
+
+      // called with mutex_ locked.  returns the lane of the handle or the
+      // path, or the number of lanes if any lane will do.
+      size_t find_route(const char* path, const struct fuse_file_info* info, bool count) {
+        if (options_.sticky_handles && info && info->fh != 0) {
+          std::map<uint64_t, size_t>::const_iterator i = handles_.find(info->fh);
+          if (i != handles_.end()) {
+            if (count) {
+              ++stats_.sticky_routes;
+            }
+            return i->second;
+          }
+        }
+        if (options_.hash_paths && path) {
+          if (count) {
+            ++stats_.hashed_routes;
+          }
+          return hash_path(path) % lanes_.size();
+        }
+        return lanes_.size();
+      }
+
+      // called with mutex_ locked.
+      size_t find_lane(lua_State* L) const {
+        std::map<lua_State*, size_t>::const_iterator i = lane_indices_.find(L);
+        if (i == lane_indices_.end()) {
+          return lanes_.size();
+        }
+        return i->second;
+      }
+
+      // called with mutex_ locked.  a free lane with a state is preferred.
+      size_t find_free_lane() const {
+        size_t result = lanes_.size();
+        for (size_t i = 0; i < lanes_.size(); ++i) {
+          if (!lanes_[i].busy) {
+            if (lanes_[i].state) {
+              return i;
+            }
+            if (result == lanes_.size()) {
+              result = i;
+            }
+          }
+        }
+        return result;
+      }
+
+      // constructs start_states in order, or fans them out over threads.
+      // when some of them fail, the error of the first failed state is
+      // thrown, no matter which thread ran into it first.
+      void bootstrap() {
+        size_t threads = std::min(std::max<size_t>(options_.bootstrap_threads, 1), start_states_);
+        size_t ready_states = start_states_;
+        if (options_.ready_states > 0) {
+          ready_states = std::min(options_.ready_states, start_states_);
+        }
+        if (threads <= 1 && ready_states == start_states_) {
+          for (size_t i = 0; i < start_states_; ++i) {
+            scoped_state state(construct(chunk_, name_, options_));
+            idle_states_.push(state.get());
+            state.release();
+          }
+          return;
+        }
+
+        for (size_t i = 0; i < threads; ++i) {
+          scoped_ptr<thread> ptr(new thread(start_bootstrap, this));
+          bootstrap_threads_.push_back(ptr.get());
+          ptr.release();
+        }
+
+        {
+          lock_guard<> lock(bootstrap_mutex_);
+          while (bootstrap_ready_ < ready_states && bootstrap_done_ < start_states_ && bootstrap_errors_.empty()) {
+            bootstrap_condition_.wait(lock);
+          }
+          if (bootstrap_errors_.empty()) {
+            // failures from now on are reported as they happen.
+            bootstrap_live_ = true;
+            return;
+          }
+        }
+
+        // states claimed before the cancellation are finished, so the first
+        // failed state is the same on every run.
+        join_bootstrap();
+        std::map<size_t, std::string>::const_iterator i = bootstrap_errors_.begin();
+        std::ostringstream out;
+        out << "could not construct state " << (i->first + 1) << ": " << i->second;
+        throw std::runtime_error(out.str());
+      }
+
+      static void* start_bootstrap(void* self) {
+        static_cast<state_manager_pool*>(self)->run_bootstrap();
+        return 0;
+      }
+
+      void run_bootstrap() {
+        while (!bootstrap_cancel_) {
+          size_t i = __sync_fetch_and_add(&bootstrap_next_, 1);
+          if (i >= start_states_) {
+            return;
+          }
+          std::string what;
+          try {
+            scoped_state state(construct(chunk_, name_, options_));
+            if (idle_states_.push(state.get())) {
+              state.release();
+            }
+          } catch (const std::exception& e) {
+            what = e.what();
+            if (what.empty()) {
+              what = "unknown error";
+            }
+          }
+          {
+            lock_guard<> lock(bootstrap_mutex_);
+            ++bootstrap_done_;
+            if (what.empty()) {
+              ++bootstrap_ready_;
+            } else {
+              bootstrap_errors_[i] = what;
+              if (bootstrap_live_) {
+                DROMOZOA_UNEXPECTED(what.c_str());
+              }
+            }
+            bootstrap_condition_.notify_all();
+          }
+          notify();
+        }
+      }
+
+      void join_bootstrap() {
+        bootstrap_cancel_ = true;
+        for (std::vector<thread*>::iterator i = bootstrap_threads_.begin(); i != bootstrap_threads_.end(); ++i) {
+          (*i)->join();
+          delete *i;
+        }
+        bootstrap_threads_.clear();
+      }
+
+      static void* start_maintenance(void* self) {
+        static_cast<state_manager_pool*>(self)->maintain();
+        return 0;
+      }
+
+      void wake_maintenance() {
+        lock_guard<> lock(maintenance_mutex_);
+        wakeup_ = true;
+        maintenance_condition_.notify_one();
+      }
+
+      void maintain() {
+        double interval = options_.maintenance_interval > 0 ? options_.maintenance_interval : 1;
+        double reaped_at = now();
+        while (true) {
+          {
+            lock_guard<> lock(maintenance_mutex_);
+            if (!stopping_ && !wakeup_) {
+              struct timespec ts = to_timespec(now() + interval);
+              pthread_cond_timedwait(maintenance_condition_.native_handle(), lock.mutex()->native_handle(), &ts);
+            }
+            if (stopping_) {
+              return;
+            }
+            wakeup_ = false;
+          }
+          prewarm();
+          if (options_.idle_timeout > 0 && now() - reaped_at >= options_.idle_timeout) {
+            reap();
+            reaped_at = now();
+          }
+        }
+      }
+
+      // constructs states until there are enough spares or the waiters are
+      // served.
+      void prewarm() {
+        while (idle_states_.size() < options_.min_spare_states || (waiters_ > 0 && idle_states_.size() == 0)) {
+          if (stopping_ || !reserve()) {
+            return;
+          }
+          lua_State* L = 0;
+          try {
+            L = construct(chunk_, name_, options_);
+          } catch (const std::exception& e) {
+            DROMOZOA_UNEXPECTED(e.what());
+            __sync_sub_and_fetch(&active_states_, 1);
+            return;
+          }
+          if (idle_states_.push(L)) {
+            __sync_sub_and_fetch(&active_states_, 1);
+            notify();
+          } else {
+            lua_close(L);
+            __sync_sub_and_fetch(&active_states_, 1);
+            return;
+          }
+          lock_guard<> lock(mutex_);
+          ++stats_.spares;
+        }
+      }
+
+      // the stack is LIFO, so the states which were not popped since the last
+      // round have been idle for the whole round and lie at the bottom.  they
+      // are closed from there, and the warm states on top are kept.
+      void reap() {
+        size_t low = std::min(idle_states_.reset_low(), idle_states_.size());
+        size_t n = low > options_.min_spare_states ? low - options_.min_spare_states : 0;
+        std::vector<lua_State*> states;
+        size_t reaped = idle_states_.pop_bottom(n, &states);
+        notify();
+        for (size_t i = 0; i < states.size(); ++i) {
+          lua_close(states[i]);
+        }
+        idle_states_.reset_low();
+        lock_guard<> lock(mutex_);
+        stats_.reaped += reaped;
+      }
+
+      // returns false when the deadline has passed.
+      bool wait(lock_guard<>& lock, double start) {
+        if (options_.wait_timeout <= 0) {
+          condition_.wait(lock);
+          return true;
+        }
+        double deadline = start + options_.wait_timeout;
+        if (now() >= deadline) {
+          return false;
+        }
+        struct timespec ts = to_timespec(deadline);
+        int result = pthread_cond_timedwait(condition_.native_handle(), lock.mutex()->native_handle(), &ts);
+        if (result == 0 || result == ETIMEDOUT) {
+          return true;
+        }
+        throw system_error(result);
+      }
+
+      // counts a new active state unless the pool is full.
+      bool reserve() {
+        while (true) {
+          size_t active_states = active_states_;
+          if (active_states >= max_states_) {
+            return false;
+          }
+          if (__sync_bool_compare_and_swap(&active_states_, active_states, active_states + 1)) {
+            return true;
+          }
+        }
+      }
+
+      lua_State* construct_reserved() {
+        try {
+          return construct(chunk_, name_, options_);
+        } catch (...) {
+          __sync_sub_and_fetch(&active_states_, 1);
+          notify();
+          throw;
+        }
+      }
+
+      void release(lua_State* L) {
+        bool full = options_.idle_timeout > 0 ? false : idle_states_.size() >= max_idle_states_;
+        if (full || !idle_states_.push(L)) {
+          lua_close(L);
+        }
+        __sync_sub_and_fetch(&active_states_, 1);
+        notify();
+      }
+
+      void notify() {
+        if (__sync_add_and_fetch(&waiters_, 0) > 0) {
+          lock_guard<> lock(mutex_);
+          condition_.notify_one();
+        }
+      }
+
+      slot* get_slot() {
+        slot* s = static_cast<slot*>(pthread_getspecific(key_));
+        if (!s) {
+          scoped_ptr<slot> ptr(new slot(this));
+          {
+            lock_guard<> lock(mutex_);
+            slots_.push_back(ptr.get());
+          }
+          s = ptr.release();
+          pthread_setspecific(key_, s);
+        }
+        return s;
+      }
+
+      // called with mutex_ locked.
+      lua_State* steal() {
+        for (std::list<slot*>::iterator i = slots_.begin(); i != slots_.end(); ++i) {
+          if (lua_State* L = (*i)->state) {
+            if (__sync_bool_compare_and_swap(&(*i)->state, L, 0)) {
+              return L;
+            }
+          }
+        }
+        return 0;
+      }
 
       state_manager_pool(const state_manager_pool&);
       state_manager_pool& operator=(const state_manager_pool&);
     };
 
+    void destroy_slot(void* ptr) {
+      slot* s = static_cast<slot*>(ptr);
+      s->self->release_slot(s);
+    }
+
     void impl_pool(lua_State* L) {
       size_t start_states = luaX_check_integer<size_t>(L, 1);
       size_t max_states = luaX_check_integer<size_t>(L, 2);
       size_t max_idle_states = luaX_check_integer<size_t>(L, 3);
       luaX_string_reference chunk = luaX_check_string(L, 4);
       luaX_string_reference name = luaX_check_string(L, 5);
-      luaX_new<state_manager_pool>(L, start_states, max_states, max_idle_states, std::string(chunk.data(), chunk.size()), std::string(name.data(), name.size()));
+      pool_options options = {};
+      check_pool_options(L, 6, &options);
+      luaX_new<state_manager_pool>(L, start_states, max_states, max_idle_states, std::string(chunk.data(), chunk.size()), std::string(name.data(), name.size()), options);
       luaX_set_metatable(L, "dromozoa.fuse.state_manager");
     }
   }
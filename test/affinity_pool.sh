@@ -0,0 +1,46 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+# two sticky states serve four readers; the states parked by the threads
+# which finished first must be handed over to the waiting threads.
+t=`lua -e "local unix = require 'dromozoa.unix' print(unix.clock_gettime(unix.CLOCK_MONOTONIC):tostring())"`
+
+cat "$mount_point/slow1.txt" >test-affinity1.txt &
+pid1=$!
+cat "$mount_point/slow2.txt" >test-affinity2.txt &
+pid2=$!
+cat "$mount_point/slow3.txt" >test-affinity3.txt &
+pid3=$!
+cat "$mount_point/slow4.txt" >test-affinity4.txt &
+pid4=$!
+
+wait "$pid1" "$pid2" "$pid3" "$pid4"
+t=`lua -e "local unix = require 'dromozoa.unix' print(math.floor((unix.clock_gettime(unix.CLOCK_MONOTONIC):tonumber() - $t) * 1000))"`
+
+for i in 1 2 3 4
+do
+  echo "[[[[`cat test-affinity$i.txt`]]]]"
+done
+rm test-affinity1.txt test-affinity2.txt test-affinity3.txt test-affinity4.txt
+echo "[[[[$t]]]]"
+
+if test "$t" -lt 400 -o 800 -lt "$t"
+then
+  exit 1
+fi
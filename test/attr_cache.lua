@@ -0,0 +1,92 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local data = "hello world\n"
+local mode = tonumber("0644", 8)
+local count = 0
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/hello.txt" then
+    count = count + 1
+    return {
+      st_mode = unix.bor(unix.S_IFREG, mode);
+      st_nlink = 1;
+      st_size = #data;
+    }
+  elseif path == "/count.txt" or path == "/invalidate.txt" then
+    -- not cached
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0444", 8));
+      st_nlink = 1;
+      st_size = 64;
+    }, 0
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:chmod(path, m)
+  if path == "/hello.txt" then
+    mode = m
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:read(path, size, offset)
+  if path == "/hello.txt" then
+    return data:sub(offset + 1, offset + size)
+  elseif path == "/count.txt" then
+    return ("%-63d\n"):format(count)
+  elseif path == "/invalidate.txt" then
+    assert(fuse.invalidate "/hello.txt")
+    return ("%-63s\n"):format(fuse.stats().attr_cache.invalidations)
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:statfs(path)
+  return {}
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "hello.txt"
+    fill "count.txt"
+    fill "invalidate.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+-- the kernel does not cache attributes, so that every stat reaches the
+-- attribute cache.
+local result = fuse.main({ arg[0], "-o", "attr_timeout=0,entry_timeout=0", ... }, fuse.state_manager.main(operations), { attr_timeout = 60 })
+assert(result == 0)
@@ -0,0 +1,36 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+count() {
+  expr "X`cat "$mount_point/count.txt"`" : 'X\([0-9]*\)'
+}
+
+ls -l "$mount_point/hello.txt"
+ls -l "$mount_point/hello.txt"
+ls -l "$mount_point/hello.txt"
+test "`count`" -eq 1
+
+chmod 600 "$mount_point/hello.txt"
+ls -l "$mount_point/hello.txt"
+ls -l "$mount_point/hello.txt"
+test "`count`" -eq 2
+
+cat "$mount_point/invalidate.txt"
+ls -l "$mount_point/hello.txt"
+test "`count`" -eq 3
@@ -0,0 +1,35 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+cat "$mount_point/data.txt" >/dev/null
+first=`cat "$mount_point/count.txt"`
+cat "$mount_point/data.txt" >/dev/null
+cat "$mount_point/data.txt" >/dev/null
+second=`cat "$mount_point/count.txt"`
+echo "[[[[$first $second]]]]"
+test "$first" -ge 3
+test "$first" -eq "$second"
+
+echo "tail" >>"$mount_point/data.txt"
+case X`tail -n 1 "$mount_point/data.txt"` in
+  X*0123456789abcdeftail) ;;
+  *) exit 1;;
+esac
+third=`cat "$mount_point/count.txt"`
+test "$third" -gt "$second"
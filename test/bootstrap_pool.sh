@@ -0,0 +1,32 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+# two states are ready at mount time and the rest are constructed by the
+# bootstrap threads while the readers are running.
+pids=
+for i in 0 1 2 3 4 5 6 7; do
+  cat "$mount_point/slow$i.txt" >/dev/null &
+  pids="$pids $!"
+done
+wait $pids
+
+stats=`cat "$mount_point/stats.txt"`
+echo "[[[[$stats]]]]"
+failures=`expr "X$stats" : 'X\([0-9]*\)'`
+test "$failures" -eq 0
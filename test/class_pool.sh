@@ -0,0 +1,33 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+# the slow readers hold the only state of the data class, while the
+# directory is listed by the states of the other classes.
+cat "$mount_point/slow1.txt" >/dev/null &
+pid1=$!
+cat "$mount_point/slow2.txt" >/dev/null &
+pid2=$!
+cat "$mount_point/slow3.txt" >/dev/null &
+pid3=$!
+sleep 0.2
+
+ls -l "$mount_point"
+kill -0 "$pid3"
+
+wait "$pid1" "$pid2" "$pid3"
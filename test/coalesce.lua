@@ -0,0 +1,81 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local count = 0
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/attr.txt" or path == "/count.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+      st_nlink = 1;
+      st_size = 64;
+    }
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:open(path, info)
+  if path == "/count.txt" then
+    info.direct_io = 1
+  end
+  return 0
+end
+
+function operations:read(path, size, offset)
+  if path == "/count.txt" then
+    local stats = fuse.stats().singleflight
+    return ("%-63s\n"):format(count .. " " .. stats.followers)
+  else
+    return ("%-63s\n"):format "attr"
+  end
+end
+
+-- slow enough that the concurrent callers arrive while it is in flight.
+function operations:getxattr(path, name, size, position)
+  if name == "user.dromozoa.foo" then
+    count = count + 1
+    unix.nanosleep(0.5)
+    return "17"
+  else
+    error(-unix.ENODATA, 0)
+  end
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "attr.txt"
+    fill "count.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations), { coalesce = 1 })
+assert(result == 0)
@@ -0,0 +1,46 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+if xattr >/dev/null 2>&1
+then
+  get_xattr() {
+    xattr -p "$1" "$mount_point/attr.txt"
+  }
+elif attr -l / >/dev/null 2>&1
+then
+  get_xattr() {
+    attr -q -g "`expr "X$1" : 'Xuser\.\(.*\)'`" "$mount_point/attr.txt"
+  }
+else
+  exit 0
+fi
+
+# each caller probes the size and fetches the value.
+get_xattr user.dromozoa.foo >/dev/null &
+get_xattr user.dromozoa.foo >/dev/null &
+get_xattr user.dromozoa.foo >/dev/null &
+get_xattr user.dromozoa.foo >/dev/null &
+wait
+
+stats=`cat "$mount_point/count.txt"`
+echo "[[[[$stats]]]]"
+count=`expr "X$stats" : 'X\([0-9]*\) '`
+followers=`expr "X$stats" : 'X[0-9]* \([0-9]*\)'`
+test "$followers" -gt 0
+test "$count" -lt 8
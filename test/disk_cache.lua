@@ -0,0 +1,113 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local dir = os.tmpname()
+os.remove(dir)
+
+local data = ("0123456789abcdef"):rep(625)
+local version = 1
+local read_count = 0
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/data.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+      st_nlink = 1;
+      st_size = #data;
+    }
+  elseif path == "/count.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0444", 8));
+      st_nlink = 1;
+      st_size = 16;
+    }
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+-- the version of data.txt is its validation token.  count.txt bypasses the
+-- caches.
+function operations:open(path, info)
+  if path == "/count.txt" then
+    info.direct_io = 1
+    return 0
+  elseif path == "/data.txt" then
+    return 0, "v" .. version
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:read(path, size, offset)
+  if path == "/data.txt" then
+    read_count = read_count + 1
+    return data:sub(offset + 1, offset + size)
+  elseif path == "/count.txt" then
+    return ("%-15d\n"):format(read_count):sub(offset + 1, offset + size)
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:write(path, buffer, offset)
+  if path == "/data.txt" then
+    data = data:sub(1, offset) .. buffer .. data:sub(offset + #buffer + 1)
+    version = version + 1
+    return #buffer
+  else
+    error(-unix.EACCES, 0)
+  end
+end
+
+function operations:truncate(path, size)
+  if path == "/data.txt" then
+    data = data:sub(1, size)
+    version = version + 1
+  else
+    error(-unix.EACCES, 0)
+  end
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "data.txt"
+    fill "count.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations), {
+  block_size = 4096;
+  disk_cache_dir = dir;
+  disk_cache_size = 1048576;
+})
+os.execute("rm -fr '" .. dir .. "'")
+assert(result == 0)
@@ -0,0 +1,40 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+for i in 1 2 3 4 5 6 7 8
+do
+  dd if=/dev/zero of="$mount_point/$i.dat" bs=4096 count=1 conv=fsync 2>/dev/null &
+done
+wait
+
+# only the failed member gets the error.
+: >"$mount_point/fail.txt"
+if dd if=/dev/zero of="$mount_point/fail.txt" bs=4096 count=1 conv=notrunc,fsync 2>/dev/null
+then
+  exit 1
+fi
+
+stats=`cat "$mount_point/stats.txt"`
+echo "[[[[$stats]]]]"
+batches=`expr "X$stats" : 'X\([0-9]*\) '`
+members=`expr "X$stats" : 'X[0-9]* \([0-9]*\) '`
+max_members=`expr "X$stats" : 'X[0-9]* [0-9]* \([0-9]*\)'`
+test "$members" -ge 9
+test "$batches" -lt "$members"
+test "$max_members" -gt 1
@@ -0,0 +1,84 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local readlink_count = 0
+local statfs_count = 0
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/link" then
+    return {
+      st_mode = unix.bor(unix.S_IFLNK, tonumber("0777", 8));
+      st_nlink = 1;
+      st_size = #"count.txt";
+    }
+  elseif path == "/count.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0444", 8));
+      st_nlink = 1;
+      st_size = 64;
+    }
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:readlink(path)
+  if path == "/link" then
+    readlink_count = readlink_count + 1
+    return "count.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+-- the result is memoized for a minute instead of the default.
+function operations:statfs(path)
+  statfs_count = statfs_count + 1
+  return {}, 60
+end
+
+function operations:read(path, size, offset)
+  if path == "/count.txt" then
+    return ("%-63s\n"):format(readlink_count .. " " .. statfs_count)
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "link"
+    fill "count.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations), { memo_timeout = 10 })
+assert(result == 0)
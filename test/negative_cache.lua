@@ -0,0 +1,88 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local files = {}
+local count = 0
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/count.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0444", 8));
+      st_nlink = 1;
+      st_size = 64;
+    }
+  elseif files[path] then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+      st_nlink = 1;
+    }
+  else
+    count = count + 1
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:create(path, mode, info)
+  files[path] = true
+end
+
+function operations:utimens(path, times)
+  if not files[path] then
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:read(path, size, offset)
+  if path == "/count.txt" then
+    local stats = fuse.stats().attr_cache
+    return ("%-63s\n"):format(count .. " " .. stats.negative_hits)
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:statfs(path)
+  return {}
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "count.txt"
+    for path in pairs(files) do
+      fill(path:sub(2))
+    end
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+-- the kernel does not cache lookups, so that every probe reaches the
+-- negative cache.
+local result = fuse.main({ arg[0], "-o", "attr_timeout=0,entry_timeout=0,negative_timeout=0", ... }, fuse.state_manager.main(operations), { negative_timeout = 60 })
+assert(result == 0)
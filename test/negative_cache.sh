@@ -0,0 +1,37 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+for i in 1 2 3 4
+do
+  if test -f "$mount_point/missing.txt"
+  then
+    exit 1
+  fi
+done
+
+stats=`cat "$mount_point/count.txt"`
+echo "[[[[$stats]]]]"
+count=`expr "X$stats" : 'X\([0-9]*\) '`
+hits=`expr "X$stats" : 'X[0-9]* \([0-9]*\)'`
+test "$count" -eq 1
+test "$hits" -ge 3
+
+# the creation invalidates the cached result.
+touch "$mount_point/missing.txt"
+test -f "$mount_point/missing.txt"
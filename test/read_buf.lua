@@ -0,0 +1,84 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local data = "hello world\n"
+
+local filename = os.tmpname()
+local out = assert(io.open(filename, "w"))
+out:write("xx", data)
+out:close()
+local fd = assert(unix.open(filename, unix.O_RDONLY))
+os.remove(filename)
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/fd.txt" or path == "/string.txt" or path == "/fallback.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+      st_nlink = 1;
+      st_size = #data;
+    }
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:read_buf(path, size, offset)
+  if path == "/fd.txt" then
+    -- the backing file has a two byte prefix.
+    return fd:get(), offset + 2, math.max(#data - offset, 0)
+  elseif path == "/string.txt" then
+    return data:sub(offset + 1, offset + size)
+  elseif path == "/fallback.txt" then
+    return nil
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:read(path, size, offset)
+  return data:sub(offset + 1, offset + size)
+end
+
+function operations:statfs(path)
+  return {}
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "fd.txt"
+    fill "string.txt"
+    fill "fallback.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations))
+assert(result == 0)
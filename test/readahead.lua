@@ -0,0 +1,86 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local data = ("0123456789abcdef"):rep(65536)
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/data.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0444", 8));
+      st_nlink = 1;
+      st_size = #data;
+    }
+  elseif path == "/stats.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0444", 8));
+      st_nlink = 1;
+      st_size = 64;
+    }
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+-- stats.txt bypasses the block cache.
+function operations:open(path, info)
+  if path == "/stats.txt" then
+    info.direct_io = 1
+  elseif path ~= "/data.txt" then
+    error(-unix.ENOENT, 0)
+  end
+  return 0
+end
+
+function operations:read(path, size, offset)
+  if path == "/data.txt" then
+    unix.nanosleep(0.001)
+    return data:sub(offset + 1, offset + size)
+  elseif path == "/stats.txt" then
+    local stats = fuse.stats().readahead
+    return ("%-63s\n"):format(stats.fetched .. " " .. stats.used .. " " .. stats.sequential_streams):sub(offset + 1, offset + size)
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "data.txt"
+    fill "stats.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations), {
+  block_size = 4096;
+  block_cache_size = 4 * 1024 * 1024;
+  readahead_blocks = 64;
+})
+assert(result == 0)
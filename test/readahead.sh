@@ -0,0 +1,35 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+expected=`mktemp`
+lua -e 'io.write(("0123456789abcdef"):rep(65536))' >"$expected"
+if cmp "$expected" "$mount_point/data.txt"
+then
+  rm -f "$expected"
+else
+  rm -f "$expected"
+  exit 1
+fi
+
+stats=`cat "$mount_point/stats.txt"`
+echo "[[[[$stats]]]]"
+fetched=`expr "X$stats" : 'X\([0-9]*\) '`
+sequential_streams=`expr "X$stats" : 'X[0-9]* [0-9]* \([0-9]*\)'`
+test "$fetched" -gt 0
+test "$sequential_streams" -ge 1
@@ -0,0 +1,95 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local data = ("0123456789abcdef"):rep(8192)
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/data.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+      st_nlink = 1;
+      st_size = #data;
+    }
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:open(path, info)
+  if path ~= "/data.txt" then
+    error(-unix.ENOENT, 0)
+  end
+  return 0
+end
+
+function operations:read(path, size, offset)
+  if path == "/data.txt" then
+    return data:sub(offset + 1, offset + size)
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+-- the gap between the end of the file and the offset is filled with zeros.
+function operations:write(path, buffer, offset)
+  if path == "/data.txt" then
+    if #data < offset then
+      data = data .. ("\0"):rep(offset - #data)
+    end
+    data = data:sub(1, offset) .. buffer .. data:sub(offset + #buffer + 1)
+    return #buffer
+  else
+    error(-unix.EACCES, 0)
+  end
+end
+
+function operations:truncate(path, size)
+  if path == "/data.txt" then
+    data = data:sub(1, size)
+  else
+    error(-unix.EACCES, 0)
+  end
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "data.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+-- reads of one block keep the readahead issuing its window past the end.
+local result = fuse.main({ arg[0], "-o", "max_read=4096", ... }, fuse.state_manager.main(operations), {
+  block_size = 4096;
+  block_cache_size = 4 * 1024 * 1024;
+  readahead_blocks = 8;
+})
+assert(result == 0)
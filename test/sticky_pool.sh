@@ -0,0 +1,37 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+# each reader is served by the state which opened its file, so the handle
+# is found in the table of that state.
+cat "$mount_point/slow1.txt" >/dev/null &
+pid1=$!
+cat "$mount_point/slow2.txt" >/dev/null &
+pid2=$!
+cat "$mount_point/slow3.txt" >/dev/null &
+pid3=$!
+cat "$mount_point/slow4.txt" >/dev/null &
+pid4=$!
+wait "$pid1" && wait "$pid2" && wait "$pid3" && wait "$pid4"
+
+stats=`cat "$mount_point/stats.txt"`
+echo "[[[[$stats]]]]"
+routes=`expr "X$stats" : 'X\([0-9]*\) '`
+handles=`expr "X$stats" : 'X[0-9]* \([0-9]*\)'`
+test "$routes" -ge 4
+test "$handles" -ge 1
@@ -0,0 +1 @@
+_driver
\ No newline at end of file
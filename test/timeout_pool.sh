@@ -0,0 +1,52 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+# one state serves two readers; the second reader gives up after 0.1 seconds
+# while the first one holds the state for 0.5 seconds.
+cat "$mount_point/slow1.txt" >/dev/null &
+pid1=$!
+sleep 0.1
+cat "$mount_point/slow2.txt" >/dev/null &
+pid2=$!
+
+failures=0
+if wait "$pid1"
+then
+  :
+else
+  failures=`expr "$failures" + 1`
+fi
+if wait "$pid2"
+then
+  :
+else
+  failures=`expr "$failures" + 1`
+fi
+echo "[[[[$failures]]]]"
+case X$failures in
+  X1) ;;
+  *) exit 1;;
+esac
+
+stats=`cat "$mount_point/stats.txt"`
+echo "[[[[$stats]]]]"
+waits=`expr "X$stats" : 'X\([0-9]*\) '`
+timeouts=`expr "X$stats" : 'X[0-9]* \([0-9]*\)'`
+test "$waits" -ge 1
+test "$timeouts" -ge 1
@@ -0,0 +1,76 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local data = "hello world\n"
+
+local operations = {}
+
+function operations:getattr(path, st)
+  if path == "/" then
+    st.st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8))
+    st.st_nlink = 2
+  elseif path == "/hello.txt" then
+    st.st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8))
+    st.st_nlink = 1
+    st.st_size = #data
+    st.st_mtime = 1234567890.5
+    assert(st.st_mtim == 1234567890.5)
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:open(path, info)
+  if path == "/hello.txt" then
+    assert(info.fh == 0)
+    info.fh = 42
+    return 0
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:read(path, size, offset, info)
+  assert(info.fh == 42)
+  return data:sub(offset + 1, offset + size)
+end
+
+function operations:release(path, info)
+  assert(info.fh == 42)
+  return 0
+end
+
+function operations:statfs(path, st)
+  st.f_bsize = 4096
+  st.f_namemax = 255
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "hello.txt"
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations), { use_views = 1 })
+assert(result == 0)
@@ -0,0 +1,37 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+df "$mount_point"
+
+case X`cat "$mount_point/hello.txt"` in
+  "Xhello world") ;;
+  *) exit 1;;
+esac
+
+size=`wc -c <"$mount_point/hello.txt"`
+size=`expr "X$size" : 'X *\([0-9][0-9]*\)$'`
+case X$size in
+  X12) ;;
+  *) exit 1;;
+esac
+
+if test -f "$mount_point/no_such_file"
+then
+  exit 1
+fi
@@ -0,0 +1,50 @@
+# Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+#
+# This file is part of dromozoa-fuse.
+#
+# dromozoa-fuse is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dromozoa-fuse is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+mount_point=$1
+
+expected=`mktemp`
+dd if=/dev/zero of="$expected" bs=4096 count=64 2>/dev/null
+dd if=/dev/zero of="$mount_point/zero.dat" bs=4096 count=64 2>/dev/null
+if cmp "$expected" "$mount_point/zero.dat"
+then
+  rm -f "$expected"
+else
+  rm -f "$expected"
+  exit 1
+fi
+
+echo "hello world" >"$mount_point/hello.txt"
+echo "HELLO" >>"$mount_point/hello.txt"
+case X`tail -n 1 "$mount_point/hello.txt"` in
+  XHELLO) ;;
+  *) exit 1;;
+esac
+
+# the error of the queued write is reported by fsync.
+: >"$mount_point/fail.txt"
+if dd if=/dev/zero of="$mount_point/fail.txt" bs=4096 count=1 conv=notrunc,fsync 2>/dev/null
+then
+  exit 1
+fi
+
+stats=`cat "$mount_point/stats.txt"`
+echo "[[[[$stats]]]]"
+pushed=`expr "X$stats" : 'X\([0-9]*\) '`
+errors=`expr "X$stats" : 'X[0-9]* \([0-9]*\)'`
+test "$pushed" -gt 0
+test "$errors" -gt 0
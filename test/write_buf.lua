@@ -0,0 +1,110 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local filename = os.tmpname()
+local fd = assert(unix.open(filename, unix.O_RDWR))
+os.remove(filename)
+
+local sizes = {}
+local files = {}
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif sizes[path] then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+      st_nlink = 1;
+      st_size = sizes[path];
+    }
+  elseif files[path] then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+      st_nlink = 1;
+      st_size = #files[path];
+    }
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:create(path, mode, info)
+  if path == "/fd.txt" then
+    sizes[path] = 0
+  else
+    files[path] = ""
+  end
+end
+
+function operations:truncate(path, size)
+  if path == "/fd.txt" then
+    sizes[path] = size
+  else
+    files[path] = files[path]:sub(1, size)
+  end
+end
+
+function operations:write_buf(path, size, offset)
+  if path == "/fd.txt" then
+    sizes[path] = math.max(sizes[path], offset + size)
+    return fd:get(), offset
+  end
+end
+
+function operations:write(path, data, offset)
+  local file = files[path]
+  files[path] = file:sub(1, offset) .. data .. file:sub(offset + #data + 1)
+end
+
+function operations:read_buf(path, size, offset)
+  if path == "/fd.txt" then
+    return fd:get(), offset, math.max(sizes[path] - offset, 0)
+  else
+    return files[path]:sub(offset + 1, offset + size)
+  end
+end
+
+function operations:statfs(path)
+  return {}
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    for name in pairs(sizes) do
+      fill(name:sub(2))
+    end
+    for name in pairs(files) do
+      fill(name:sub(2))
+    end
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations))
+assert(result == 0)
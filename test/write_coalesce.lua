@@ -0,0 +1,97 @@
+-- Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+--
+-- This file is part of dromozoa-fuse.
+--
+-- dromozoa-fuse is free software: you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation, either version 3 of the License, or
+-- (at your option) any later version.
+--
+-- dromozoa-fuse is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+local unix = require "dromozoa.unix"
+local fuse = require "dromozoa.fuse"
+
+local files = {}
+local write_count = 0
+
+local operations = {}
+
+function operations:getattr(path)
+  if path == "/" then
+    return {
+      st_mode = unix.bor(unix.S_IFDIR, tonumber("0755", 8));
+      st_nlink = 2;
+    }
+  elseif path == "/count.txt" then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0444", 8));
+      st_nlink = 1;
+      st_size = 16;
+    }
+  end
+  local data = files[path]
+  if data then
+    return {
+      st_mode = unix.bor(unix.S_IFREG, tonumber("0644", 8));
+      st_nlink = 1;
+      st_size = #data;
+    }
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:create(path, mode, info)
+  files[path] = ""
+end
+
+-- count.txt bypasses the page cache.
+function operations:open(path, info)
+  if path == "/count.txt" then
+    info.direct_io = 1
+  elseif not files[path] then
+    error(-unix.ENOENT, 0)
+  end
+end
+
+function operations:truncate(path, size)
+  files[path] = files[path]:sub(1, size)
+end
+
+function operations:read(path, size, offset)
+  if path == "/count.txt" then
+    return ("%-15d\n"):format(write_count):sub(offset + 1, offset + size)
+  end
+  return files[path]:sub(offset + 1, offset + size)
+end
+
+function operations:write(path, buffer, offset)
+  write_count = write_count + 1
+  local data = files[path]
+  files[path] = data:sub(1, offset) .. buffer .. data:sub(offset + #buffer + 1)
+end
+
+function operations:readdir(path, fill)
+  if path == "/" then
+    fill "."
+    fill ".."
+    fill "count.txt"
+    for name in pairs(files) do
+      fill(name:sub(2))
+    end
+  else
+    error(-unix.ENOENT, 0)
+  end
+end
+
+local result = fuse.main({ arg[0], ... }, fuse.state_manager.main(operations), {
+  write_coalesce_size = 65536;
+})
+assert(result == 0)
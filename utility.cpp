@@ -0,0 +1,65 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <sys/time.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace dromozoa {
+  namespace {
+    double wall_clock() {
+      struct timeval tv = {};
+      gettimeofday(&tv, 0);
+      return tv.tv_sec + tv.tv_usec * 0.000001;
+    }
+  }
+
+  // durations and expiry are measured with the monotonic clock, so that a
+  // step of the wall clock neither keeps cached entries nor drops them.
+  double now() {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts = {};
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+      return ts.tv_sec + ts.tv_nsec * 0.000000001;
+    }
+#endif
+    return wall_clock();
+  }
+
+  // converts a deadline given by now() to the absolute time of the wall
+  // clock that pthread_cond_timedwait expects.
+  struct timespec to_timespec(double deadline) {
+    double t = wall_clock() + std::max(deadline - now(), 0.0);
+    struct timespec ts = {};
+    ts.tv_sec = static_cast<time_t>(t);
+    ts.tv_nsec = static_cast<long>((t - ts.tv_sec) * 1000000000);
+    if (ts.tv_nsec >= 1000000000) {
+      ++ts.tv_sec;
+      ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+  }
+
+  bool is_descendant(const std::string& path, const std::string& prefix) {
+    return path.size() > prefix.size()
+        && path.compare(0, prefix.size(), prefix) == 0
+        && (prefix == "/" || path[prefix.size()] == '/');
+  }
+}
@@ -0,0 +1,448 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#define DROMOZOA_SET_FIELD_CODE(name) \
+  luaX_set_field(L, -1, #name, static_cast<int>(field_##name)) \
+  /**/
+
+#define DROMOZOA_GET_CASE(name) \
+  case field_##name: \
+    luaX_push(L, that->name); \
+    break \
+  /**/
+
+#define DROMOZOA_SET_CASE(name) \
+  case field_##name: \
+    check_integer(L, 3, that->name); \
+    break \
+  /**/
+
+#define DROMOZOA_SET_BIT_CASE(name) \
+  case field_##name: \
+    that->name = luaX_check_integer<unsigned int>(L, 3, 0, 1); \
+    break \
+  /**/
+
+namespace dromozoa {
+  namespace {
+    template <class T>
+    void check_integer(lua_State* L, int arg, T& target) {
+      target = luaX_check_integer<T>(L, arg);
+    }
+
+    // a view points to a structure owned by libfuse and is valid only while
+    // the callback is running.  writes go straight to the structure, so no
+    // write-back is needed and dirty() tells whether the handler wrote at all.
+    template <class T>
+    class view_impl : public view {
+    public:
+      explicit view_impl(T* ptr)
+        : ptr_(ptr),
+          dirty_() {}
+
+      virtual void reset() {
+        ptr_ = 0;
+      }
+
+      virtual bool dirty() const {
+        return dirty_;
+      }
+
+      T* get() const {
+        if (!ptr_) {
+          throw std::runtime_error("out of scope");
+        }
+        return ptr_;
+      }
+
+      void touch() {
+        dirty_ = true;
+      }
+
+    private:
+      T* ptr_;
+      bool dirty_;
+      view_impl(const view_impl&);
+      view_impl& operator=(const view_impl&);
+    };
+
+    // field codes are stored in the metatable, keyed by the field names.
+    int check_field(lua_State* L) {
+      if (lua_getmetatable(L, 1)) {
+        lua_pushvalue(L, 2);
+        lua_rawget(L, -2);
+        if (luaX_is_integer(L, -1)) {
+          int code = lua_tointeger(L, -1);
+          lua_pop(L, 2);
+          return code;
+        }
+        lua_pop(L, 2);
+      }
+      return 0;
+    }
+
+    void push_timespec(lua_State* L, const struct timespec& tv) {
+      luaX_push(L, tv.tv_sec + tv.tv_nsec / 1000000000.0);
+    }
+
+    struct timespec check_timespec(lua_State* L, int arg) {
+      struct timespec tv = {};
+      if (!convert(L, arg, &tv)) {
+        luaL_argerror(L, arg, "number or table expected");
+      }
+      return tv;
+    }
+
+    enum {
+      field_st_dev = 1,
+      field_st_ino,
+      field_st_mode,
+      field_st_nlink,
+      field_st_uid,
+      field_st_gid,
+      field_st_size,
+      field_st_atim,
+      field_st_mtim,
+      field_st_ctim,
+      field_st_blksize,
+      field_st_blocks
+    };
+
+    struct timespec get_atim(const struct stat* that) {
+#if defined(HAVE_STRUCT_STAT_ST_ATIM)
+      return that->st_atim;
+#elif defined(HAVE_STRUCT_STAT_ST_ATIMESPEC)
+      return that->st_atimespec;
+#else
+      struct timespec tv = {};
+      tv.tv_sec = that->st_atime;
+      return tv;
+#endif
+    }
+
+    struct timespec get_mtim(const struct stat* that) {
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+      return that->st_mtim;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+      return that->st_mtimespec;
+#else
+      struct timespec tv = {};
+      tv.tv_sec = that->st_mtime;
+      return tv;
+#endif
+    }
+
+    struct timespec get_ctim(const struct stat* that) {
+#if defined(HAVE_STRUCT_STAT_ST_CTIM)
+      return that->st_ctim;
+#elif defined(HAVE_STRUCT_STAT_ST_CTIMESPEC)
+      return that->st_ctimespec;
+#else
+      struct timespec tv = {};
+      tv.tv_sec = that->st_ctime;
+      return tv;
+#endif
+    }
+
+    void set_atim(struct stat* that, const struct timespec& tv) {
+#if defined(HAVE_STRUCT_STAT_ST_ATIM)
+      that->st_atim = tv;
+#elif defined(HAVE_STRUCT_STAT_ST_ATIMESPEC)
+      that->st_atimespec = tv;
+#else
+      that->st_atime = tv.tv_sec;
+#endif
+    }
+
+    void set_mtim(struct stat* that, const struct timespec& tv) {
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+      that->st_mtim = tv;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+      that->st_mtimespec = tv;
+#else
+      that->st_mtime = tv.tv_sec;
+#endif
+    }
+
+    void set_ctim(struct stat* that, const struct timespec& tv) {
+#if defined(HAVE_STRUCT_STAT_ST_CTIM)
+      that->st_ctim = tv;
+#elif defined(HAVE_STRUCT_STAT_ST_CTIMESPEC)
+      that->st_ctimespec = tv;
+#else
+      that->st_ctime = tv.tv_sec;
+#endif
+    }
+
+    void impl_stat_index(lua_State* L) {
+      const struct stat* that = luaX_check_udata<view_impl<struct stat> >(L, 1, "dromozoa.fuse.stat")->get();
+      switch (check_field(L)) {
+        DROMOZOA_GET_CASE(st_dev);
+        DROMOZOA_GET_CASE(st_ino);
+        DROMOZOA_GET_CASE(st_mode);
+        DROMOZOA_GET_CASE(st_nlink);
+        DROMOZOA_GET_CASE(st_uid);
+        DROMOZOA_GET_CASE(st_gid);
+        DROMOZOA_GET_CASE(st_size);
+        case field_st_atim:
+          push_timespec(L, get_atim(that));
+          break;
+        case field_st_mtim:
+          push_timespec(L, get_mtim(that));
+          break;
+        case field_st_ctim:
+          push_timespec(L, get_ctim(that));
+          break;
+        DROMOZOA_GET_CASE(st_blksize);
+        DROMOZOA_GET_CASE(st_blocks);
+        default:
+          luaX_push(L, luaX_nil);
+      }
+    }
+
+    void impl_stat_newindex(lua_State* L) {
+      view_impl<struct stat>* self = luaX_check_udata<view_impl<struct stat> >(L, 1, "dromozoa.fuse.stat");
+      struct stat* that = self->get();
+      switch (check_field(L)) {
+        DROMOZOA_SET_CASE(st_dev);
+        DROMOZOA_SET_CASE(st_ino);
+        DROMOZOA_SET_CASE(st_mode);
+        DROMOZOA_SET_CASE(st_nlink);
+        DROMOZOA_SET_CASE(st_uid);
+        DROMOZOA_SET_CASE(st_gid);
+        DROMOZOA_SET_CASE(st_size);
+        case field_st_atim:
+          set_atim(that, check_timespec(L, 3));
+          break;
+        case field_st_mtim:
+          set_mtim(that, check_timespec(L, 3));
+          break;
+        case field_st_ctim:
+          set_ctim(that, check_timespec(L, 3));
+          break;
+        DROMOZOA_SET_CASE(st_blksize);
+        DROMOZOA_SET_CASE(st_blocks);
+        default:
+          throw std::runtime_error("unknown field");
+      }
+      self->touch();
+    }
+
+    enum {
+      field_f_bsize = 1,
+      field_f_frsize,
+      field_f_blocks,
+      field_f_bfree,
+      field_f_bavail,
+      field_f_files,
+      field_f_ffree,
+      field_f_favail,
+      field_f_fsid,
+      field_f_flag,
+      field_f_namemax
+    };
+
+    void impl_statvfs_index(lua_State* L) {
+      const struct statvfs* that = luaX_check_udata<view_impl<struct statvfs> >(L, 1, "dromozoa.fuse.statvfs")->get();
+      switch (check_field(L)) {
+        DROMOZOA_GET_CASE(f_bsize);
+        DROMOZOA_GET_CASE(f_frsize);
+        DROMOZOA_GET_CASE(f_blocks);
+        DROMOZOA_GET_CASE(f_bfree);
+        DROMOZOA_GET_CASE(f_bavail);
+        DROMOZOA_GET_CASE(f_files);
+        DROMOZOA_GET_CASE(f_ffree);
+        DROMOZOA_GET_CASE(f_favail);
+        DROMOZOA_GET_CASE(f_fsid);
+        DROMOZOA_GET_CASE(f_flag);
+        DROMOZOA_GET_CASE(f_namemax);
+        default:
+          luaX_push(L, luaX_nil);
+      }
+    }
+
+    void impl_statvfs_newindex(lua_State* L) {
+      view_impl<struct statvfs>* self = luaX_check_udata<view_impl<struct statvfs> >(L, 1, "dromozoa.fuse.statvfs");
+      struct statvfs* that = self->get();
+      switch (check_field(L)) {
+        DROMOZOA_SET_CASE(f_bsize);
+        DROMOZOA_SET_CASE(f_frsize);
+        DROMOZOA_SET_CASE(f_blocks);
+        DROMOZOA_SET_CASE(f_bfree);
+        DROMOZOA_SET_CASE(f_bavail);
+        DROMOZOA_SET_CASE(f_files);
+        DROMOZOA_SET_CASE(f_ffree);
+        DROMOZOA_SET_CASE(f_favail);
+        DROMOZOA_SET_CASE(f_fsid);
+        DROMOZOA_SET_CASE(f_flag);
+        DROMOZOA_SET_CASE(f_namemax);
+        default:
+          throw std::runtime_error("unknown field");
+      }
+      self->touch();
+    }
+
+    enum {
+      field_flags = 1,
+      field_writepage,
+      field_direct_io,
+      field_keep_cache,
+      field_flush,
+      field_nonseekable,
+      field_flock_release,
+      field_fh,
+      field_lock_owner
+    };
+
+    void impl_file_info_index(lua_State* L) {
+      const struct fuse_file_info* that = luaX_check_udata<view_impl<struct fuse_file_info> >(L, 1, "dromozoa.fuse.file_info")->get();
+      switch (check_field(L)) {
+        DROMOZOA_GET_CASE(flags);
+        DROMOZOA_GET_CASE(writepage);
+        DROMOZOA_GET_CASE(direct_io);
+        DROMOZOA_GET_CASE(keep_cache);
+        DROMOZOA_GET_CASE(flush);
+        DROMOZOA_GET_CASE(nonseekable);
+#if FUSE_VERSION >= 29
+        DROMOZOA_GET_CASE(flock_release);
+#endif
+        DROMOZOA_GET_CASE(fh);
+        case field_lock_owner:
+          {
+            // lock_owner may not be represented by double
+            std::ostringstream out;
+            out << that->lock_owner;
+            luaX_push(L, out.str());
+          }
+          break;
+        default:
+          luaX_push(L, luaX_nil);
+      }
+    }
+
+    void impl_file_info_newindex(lua_State* L) {
+      view_impl<struct fuse_file_info>* self = luaX_check_udata<view_impl<struct fuse_file_info> >(L, 1, "dromozoa.fuse.file_info");
+      struct fuse_file_info* that = self->get();
+      switch (check_field(L)) {
+        DROMOZOA_SET_CASE(flags);
+        DROMOZOA_SET_BIT_CASE(writepage);
+        DROMOZOA_SET_BIT_CASE(direct_io);
+        DROMOZOA_SET_BIT_CASE(keep_cache);
+        DROMOZOA_SET_BIT_CASE(flush);
+        DROMOZOA_SET_BIT_CASE(nonseekable);
+#if FUSE_VERSION >= 29
+        DROMOZOA_SET_BIT_CASE(flock_release);
+#endif
+        DROMOZOA_SET_CASE(fh);
+        case field_lock_owner:
+          {
+            luaX_string_reference lock_owner = luaX_check_string(L, 3);
+            std::istringstream in(std::string(lock_owner.data(), lock_owner.size()));
+            in >> that->lock_owner;
+          }
+          break;
+        default:
+          throw std::runtime_error("unknown field");
+      }
+      self->touch();
+    }
+
+    template <class T>
+    view* new_view_impl(lua_State* L, T* ptr, const char* name) {
+      view_impl<T>* self = luaX_new<view_impl<T> >(L, ptr);
+      luaX_set_metatable(L, name);
+      return self;
+    }
+  }
+
+  view::~view() {}
+
+  view* new_view(lua_State* L, struct stat* ptr) {
+    return new_view_impl(L, ptr, "dromozoa.fuse.stat");
+  }
+
+  view* new_view(lua_State* L, struct statvfs* ptr) {
+    return new_view_impl(L, ptr, "dromozoa.fuse.statvfs");
+  }
+
+  view* new_view(lua_State* L, struct fuse_file_info* ptr) {
+    return new_view_impl(L, ptr, "dromozoa.fuse.file_info");
+  }
+
+  void initialize_view(lua_State* L) {
+    luaL_newmetatable(L, "dromozoa.fuse.stat");
+    luaX_set_field(L, -1, "__index", impl_stat_index);
+    luaX_set_field(L, -1, "__newindex", impl_stat_newindex);
+    DROMOZOA_SET_FIELD_CODE(st_dev);
+    DROMOZOA_SET_FIELD_CODE(st_ino);
+    DROMOZOA_SET_FIELD_CODE(st_mode);
+    DROMOZOA_SET_FIELD_CODE(st_nlink);
+    DROMOZOA_SET_FIELD_CODE(st_uid);
+    DROMOZOA_SET_FIELD_CODE(st_gid);
+    DROMOZOA_SET_FIELD_CODE(st_size);
+    DROMOZOA_SET_FIELD_CODE(st_atim);
+    DROMOZOA_SET_FIELD_CODE(st_mtim);
+    DROMOZOA_SET_FIELD_CODE(st_ctim);
+    DROMOZOA_SET_FIELD_CODE(st_blksize);
+    DROMOZOA_SET_FIELD_CODE(st_blocks);
+    luaX_set_field(L, -1, "st_atimespec", static_cast<int>(field_st_atim));
+    luaX_set_field(L, -1, "st_mtimespec", static_cast<int>(field_st_mtim));
+    luaX_set_field(L, -1, "st_ctimespec", static_cast<int>(field_st_ctim));
+    luaX_set_field(L, -1, "st_atime", static_cast<int>(field_st_atim));
+    luaX_set_field(L, -1, "st_mtime", static_cast<int>(field_st_mtim));
+    luaX_set_field(L, -1, "st_ctime", static_cast<int>(field_st_ctim));
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, "dromozoa.fuse.statvfs");
+    luaX_set_field(L, -1, "__index", impl_statvfs_index);
+    luaX_set_field(L, -1, "__newindex", impl_statvfs_newindex);
+    DROMOZOA_SET_FIELD_CODE(f_bsize);
+    DROMOZOA_SET_FIELD_CODE(f_frsize);
+    DROMOZOA_SET_FIELD_CODE(f_blocks);
+    DROMOZOA_SET_FIELD_CODE(f_bfree);
+    DROMOZOA_SET_FIELD_CODE(f_bavail);
+    DROMOZOA_SET_FIELD_CODE(f_files);
+    DROMOZOA_SET_FIELD_CODE(f_ffree);
+    DROMOZOA_SET_FIELD_CODE(f_favail);
+    DROMOZOA_SET_FIELD_CODE(f_fsid);
+    DROMOZOA_SET_FIELD_CODE(f_flag);
+    DROMOZOA_SET_FIELD_CODE(f_namemax);
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, "dromozoa.fuse.file_info");
+    luaX_set_field(L, -1, "__index", impl_file_info_index);
+    luaX_set_field(L, -1, "__newindex", impl_file_info_newindex);
+    DROMOZOA_SET_FIELD_CODE(flags);
+    DROMOZOA_SET_FIELD_CODE(writepage);
+    DROMOZOA_SET_FIELD_CODE(direct_io);
+    DROMOZOA_SET_FIELD_CODE(keep_cache);
+    DROMOZOA_SET_FIELD_CODE(flush);
+    DROMOZOA_SET_FIELD_CODE(nonseekable);
+#if FUSE_VERSION >= 29
+    DROMOZOA_SET_FIELD_CODE(flock_release);
+#endif
+    DROMOZOA_SET_FIELD_CODE(fh);
+    DROMOZOA_SET_FIELD_CODE(lock_owner);
+    lua_pop(L, 1);
+  }
+}
@@ -0,0 +1,222 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <algorithm>
+
+namespace dromozoa {
+  write_behind::write_behind(size_t max_bytes, size_t threads)
+    : max_bytes_(max_bytes),
+      thread_count_(std::max<size_t>(threads, 1)),
+      self_(),
+      write_(),
+      stopping_(),
+      sequence_(),
+      bytes_(),
+      pushed_(),
+      written_(),
+      errors_count_(),
+      backpressure_waits_(),
+      barrier_waits_() {}
+
+  write_behind::~write_behind() {
+    stop();
+  }
+
+  bool write_behind::enabled() const {
+    return max_bytes_ > 0;
+  }
+
+  void write_behind::start(operations* self, write_type write) {
+    if (!enabled() || !threads_.empty()) {
+      return;
+    }
+    self_ = self;
+    write_ = write;
+    for (size_t i = 0; i < thread_count_; ++i) {
+      threads_.push_back(new thread(start_worker, this));
+    }
+  }
+
+  // the threads write everything queued before they exit.
+  void write_behind::stop() {
+    {
+      lock_guard<> lock(mutex_);
+      stopping_ = true;
+      condition_.notify_all();
+    }
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      threads_[i]->join();
+      delete threads_[i];
+    }
+    threads_.clear();
+  }
+
+  // takes the data of the chunk.  waits while the queue holds max_bytes, so
+  // that writers are slowed down to the speed of the handler.  a chunk larger
+  // than max_bytes is accepted when the queue is empty.  returns false if
+  // the threads are not running, and the caller must write the chunk itself.
+  bool write_behind::push(write_coalescer::chunk& chunk) {
+    key_type key(chunk.path, chunk.info.fh);
+    lock_guard<> lock(mutex_);
+    if (threads_.empty() || stopping_) {
+      return false;
+    }
+    if (bytes_ > 0 && bytes_ + chunk.data.size() > max_bytes_) {
+      ++backpressure_waits_;
+      do {
+        condition_.wait(lock);
+      } while (bytes_ > 0 && bytes_ + chunk.data.size() > max_bytes_);
+    }
+    uint64_t id = ++sequence_;
+    item& that = items_[id];
+    that.key = key;
+    that.chunk.path.swap(chunk.path);
+    that.chunk.info = chunk.info;
+    that.chunk.offset = chunk.offset;
+    that.chunk.data.swap(chunk.data);
+    that.chunk.time = chunk.time;
+    queue_.push_back(id);
+    ++pending_[key];
+    bytes_ += that.chunk.data.size();
+    ++pushed_;
+    condition_.notify_all();
+    return true;
+  }
+
+  // waits until the writes of the handle are done, and returns the first
+  // error of them since the last barrier.
+  int write_behind::wait(const char* path, uint64_t fh) {
+    key_type key(path, fh);
+    lock_guard<> lock(mutex_);
+    std::map<key_type, size_t>::iterator i = pending_.find(key);
+    if (i != pending_.end()) {
+      ++barrier_waits_;
+      while ((i = pending_.find(key)) != pending_.end()) {
+        condition_.wait(lock);
+      }
+    }
+    std::map<key_type, int>::iterator j = errors_.find(key);
+    if (j == errors_.end()) {
+      return 0;
+    }
+    int result = j->second;
+    errors_.erase(j);
+    return result;
+  }
+
+  // waits until the writes of the path which overlap the range are done, or
+  // all of them if size is zero.  their errors are left to the barriers of
+  // their handles.
+  void write_behind::wait(const char* path, off_t offset, size_t size) {
+    std::string p(path);
+    lock_guard<> lock(mutex_);
+    bool waited = false;
+    while (overlaps(p, offset, size)) {
+      if (!waited) {
+        ++barrier_waits_;
+        waited = true;
+      }
+      condition_.wait(lock);
+    }
+  }
+
+  void write_behind::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "threads", threads_.size());
+    luaX_set_field(L, -1, "queued", queue_.size());
+    luaX_set_field(L, -1, "running", items_.size() - queue_.size());
+    luaX_set_field(L, -1, "bytes", bytes_);
+    luaX_set_field(L, -1, "pushed", pushed_);
+    luaX_set_field(L, -1, "written", written_);
+    luaX_set_field(L, -1, "errors", errors_count_);
+    luaX_set_field(L, -1, "deferred_errors", errors_.size());
+    luaX_set_field(L, -1, "backpressure_waits", backpressure_waits_);
+    luaX_set_field(L, -1, "barrier_waits", barrier_waits_);
+  }
+
+  void* write_behind::start_worker(void* self) {
+    static_cast<write_behind*>(self)->work();
+    return 0;
+  }
+
+  // the writes of a path are done one at a time in the order they were
+  // pushed, since writes of its handles may overlap.  writes of different
+  // paths run in parallel.
+  void write_behind::work() {
+    while (true) {
+      uint64_t id = 0;
+      item* that = 0;
+      {
+        lock_guard<> lock(mutex_);
+        while (true) {
+          std::deque<uint64_t>::iterator i = queue_.begin();
+          for (; i != queue_.end(); ++i) {
+            if (running_.find(items_[*i].key.first) == running_.end()) {
+              break;
+            }
+          }
+          if (i != queue_.end()) {
+            id = *i;
+            queue_.erase(i);
+            that = &items_[id];
+            running_.insert(that->key.first);
+            break;
+          }
+          if (stopping_ && queue_.empty()) {
+            return;
+          }
+          condition_.wait(lock);
+        }
+      }
+
+      int result = write_(self_, that->chunk);
+
+      lock_guard<> lock(mutex_);
+      if (result < 0) {
+        ++errors_count_;
+        if (errors_.find(that->key) == errors_.end()) {
+          errors_[that->key] = result;
+        }
+      } else {
+        ++written_;
+      }
+      bytes_ -= that->chunk.data.size();
+      running_.erase(that->key.first);
+      std::map<key_type, size_t>::iterator i = pending_.find(that->key);
+      if (i != pending_.end() && --i->second == 0) {
+        pending_.erase(i);
+      }
+      items_.erase(id);
+      condition_.notify_all();
+    }
+  }
+
+  // called with mutex_ locked.
+  bool write_behind::overlaps(const std::string& path, off_t offset, size_t size) const {
+    for (std::map<uint64_t, item>::const_iterator i = items_.begin(); i != items_.end(); ++i) {
+      const write_coalescer::chunk& that = i->second.chunk;
+      if (i->second.key.first == path
+          && (size == 0 || (that.offset < offset + static_cast<off_t>(size) && offset < that.offset + static_cast<off_t>(that.data.size())))) {
+        return true;
+      }
+    }
+    return false;
+  }
+}
@@ -0,0 +1,157 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+namespace dromozoa {
+  write_coalescer::write_coalescer(size_t max_bytes, double max_age)
+    : max_bytes_(max_bytes),
+      max_age_(max_age),
+      bytes_(),
+      writes_(),
+      merged_(),
+      flushes_(),
+      full_(),
+      aged_(),
+      noncontiguous_(),
+      overlaps_(),
+      barriers_() {}
+
+  bool write_coalescer::enabled() const {
+    return max_bytes_ > 0;
+  }
+
+  // buffers the write if it continues the buffer of the handle, or starts a
+  // new buffer.  the buffer it cannot join, and the buffers of other handles
+  // of the path which it overlaps, are moved to chunks, to be written before
+  // the write.  returns false if the write is too large to be buffered and
+  // must be written directly after chunks.
+  bool write_coalescer::add(const char* path, const struct fuse_file_info* info, const char* data, size_t size, off_t offset, std::vector<chunk>* chunks) {
+    key_type key(path, info->fh);
+    double time = now();
+    lock_guard<> lock(mutex_);
+    // the older data of another handle must not be written over this one
+    // later.
+    for (std::map<key_type, chunk>::iterator j = map_.lower_bound(key_type(key.first, 0)); j != map_.end() && j->first.first == key.first; ) {
+      const chunk& that = j->second;
+      if (j->first != key && that.offset < offset + static_cast<off_t>(size) && offset < that.offset + static_cast<off_t>(that.data.size())) {
+        ++overlaps_;
+        take(j++, chunks);
+      } else {
+        ++j;
+      }
+    }
+    std::map<key_type, chunk>::iterator i = map_.find(key);
+    if (i != map_.end()) {
+      chunk& that = i->second;
+      bool aged = max_age_ > 0 && time - that.time >= max_age_;
+      if (!aged && offset == that.offset + static_cast<off_t>(that.data.size()) && that.data.size() + size <= max_bytes_) {
+        that.data.append(data, size);
+        bytes_ += size;
+        ++writes_;
+        ++merged_;
+        if (that.data.size() >= max_bytes_) {
+          ++full_;
+          take(i, chunks);
+        }
+        return true;
+      }
+      if (aged) {
+        ++aged_;
+      } else if (offset == that.offset + static_cast<off_t>(that.data.size())) {
+        ++full_;
+      } else {
+        ++noncontiguous_;
+      }
+      take(i, chunks);
+    }
+    if (size >= max_bytes_) {
+      return false;
+    }
+    chunk& that = map_[key];
+    that.path = path;
+    that.info = *info;
+    that.offset = offset;
+    that.data.assign(data, size);
+    that.time = time;
+    bytes_ += size;
+    ++writes_;
+    return true;
+  }
+
+  // takes the buffer of the handle, for flush, fsync and release.
+  void write_coalescer::take(const char* path, uint64_t fh, std::vector<chunk>* chunks) {
+    lock_guard<> lock(mutex_);
+    std::map<key_type, chunk>::iterator i = map_.find(key_type(path, fh));
+    if (i != map_.end()) {
+      ++barriers_;
+      take(i, chunks);
+    }
+  }
+
+  // takes the buffers of the path which overlap the range, or all of them if
+  // size is zero.
+  void write_coalescer::take(const char* path, off_t offset, size_t size, std::vector<chunk>* chunks) {
+    std::string p(path);
+    lock_guard<> lock(mutex_);
+    std::map<key_type, chunk>::iterator i = map_.lower_bound(key_type(p, 0));
+    while (i != map_.end() && i->first.first == p) {
+      const chunk& that = i->second;
+      if (size == 0 || (that.offset < offset + static_cast<off_t>(size) && offset < that.offset + static_cast<off_t>(that.data.size()))) {
+        ++barriers_;
+        take(i++, chunks);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  void write_coalescer::take(std::vector<chunk>* chunks) {
+    lock_guard<> lock(mutex_);
+    while (!map_.empty()) {
+      take(map_.begin(), chunks);
+    }
+  }
+
+  void write_coalescer::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "buffers", map_.size());
+    luaX_set_field(L, -1, "bytes", bytes_);
+    luaX_set_field(L, -1, "writes", writes_);
+    luaX_set_field(L, -1, "merged", merged_);
+    luaX_set_field(L, -1, "flushes", flushes_);
+    luaX_set_field(L, -1, "full", full_);
+    luaX_set_field(L, -1, "aged", aged_);
+    luaX_set_field(L, -1, "noncontiguous", noncontiguous_);
+    luaX_set_field(L, -1, "overlaps", overlaps_);
+    luaX_set_field(L, -1, "barriers", barriers_);
+  }
+
+  // called with mutex_ locked.
+  void write_coalescer::take(std::map<key_type, chunk>::iterator i, std::vector<chunk>* chunks) {
+    bytes_ -= i->second.data.size();
+    ++flushes_;
+    chunks->push_back(chunk());
+    chunks->back().path.swap(i->second.path);
+    chunks->back().info = i->second.info;
+    chunks->back().offset = i->second.offset;
+    chunks->back().data.swap(i->second.data);
+    chunks->back().time = i->second.time;
+    map_.erase(i);
+  }
+}
@@ -0,0 +1,148 @@
+// Copyright (C) 2026 Tomoyuki Fujimori <moyu@dromozoa.com>
+//
+// This file is part of dromozoa-fuse.
+//
+// dromozoa-fuse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dromozoa-fuse is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dromozoa-fuse.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hpp"
+
+#include <errno.h>
+#include <string.h>
+
+namespace dromozoa {
+  namespace {
+    // the path and the name are separated by NUL, which neither contains.
+    // the list of names is keyed by the path alone.
+    std::string make_key(const char* path, const char* name) {
+      std::string key(path);
+      key += '\0';
+      if (name) {
+        key += '@';
+        key += name;
+      }
+      return key;
+    }
+  }
+
+  xattr_cache::xattr_cache(double timeout, size_t max_bytes)
+    : timeout_(timeout),
+      max_bytes_(max_bytes),
+      bytes_(),
+      generations_(),
+      hits_(),
+      misses_(),
+      evictions_() {}
+
+  uint64_t xattr_cache::generation() {
+    lock_guard<> lock(mutex_);
+    return generations_.get();
+  }
+
+  // a probe with zero size is answered with the size of the value.
+  bool xattr_cache::get(const char* path, const char* name, char* buffer, size_t size, int* result) {
+    std::string key = make_key(path, name);
+    lock_guard<> lock(mutex_);
+    std::map<std::string, list_type::iterator>::iterator i = map_.find(key);
+    if (i == map_.end()) {
+      ++misses_;
+      return false;
+    }
+    list_type::iterator item = i->second;
+    if (item->time() <= now()) {
+      erase(i);
+      ++misses_;
+      return false;
+    }
+    list_.splice(list_.begin(), list_, item);
+    ++hits_;
+    const std::string& data = item->data();
+    if (item->result() < 0) {
+      *result = item->result();
+    } else if (size == 0) {
+      *result = data.size();
+    } else if (data.size() > size) {
+      *result = -ERANGE;
+    } else {
+      memset(buffer, 0, size);
+      memcpy(buffer, data.data(), data.size());
+      *result = data.size();
+    }
+    return true;
+  }
+
+  // the item is dropped if the path was invalidated after the handler was
+  // called.
+  void xattr_cache::put(const char* path, const char* name, const char* data, size_t size, int result, uint64_t generation) {
+    if (max_bytes_ > 0 && size > max_bytes_) {
+      return;
+    }
+    std::string key = make_key(path, name);
+    lock_guard<> lock(mutex_);
+    if (!generations_.valid(path, generation)) {
+      return;
+    }
+    std::map<std::string, list_type::iterator>::iterator i = map_.find(key);
+    if (i != map_.end()) {
+      erase(i);
+    }
+    while (max_bytes_ > 0 && !list_.empty() && bytes_ + size > max_bytes_) {
+      erase(map_.find(list_.back().key()));
+      ++evictions_;
+    }
+    list_.push_front(xattr_cache_item(now() + timeout_, key, data, size, result));
+    map_[key] = list_.begin();
+    bytes_ += size;
+  }
+
+  // removes the items of the path, and of its descendants if requested.
+  void xattr_cache::invalidate(const char* path, bool descendants) {
+    std::string prefix(path);
+    lock_guard<> lock(mutex_);
+    generations_.invalidate(prefix, descendants);
+    std::map<std::string, list_type::iterator>::iterator i = map_.lower_bound(prefix);
+    while (i != map_.end() && i->first.compare(0, prefix.size(), prefix) == 0) {
+      char c = i->first[prefix.size()];
+      if (c == '\0' || (descendants && (c == '/' || prefix == "/"))) {
+        erase(i++);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  void xattr_cache::invalidate() {
+    lock_guard<> lock(mutex_);
+    generations_.invalidate();
+    map_.clear();
+    list_.clear();
+    bytes_ = 0;
+  }
+
+  void xattr_cache::stats(lua_State* L) {
+    lock_guard<> lock(mutex_);
+    lua_newtable(L);
+    luaX_set_field(L, -1, "entries", map_.size());
+    luaX_set_field(L, -1, "bytes", bytes_);
+    luaX_set_field(L, -1, "hits", hits_);
+    luaX_set_field(L, -1, "misses", misses_);
+    luaX_set_field(L, -1, "evictions", evictions_);
+  }
+
+  // called with mutex_ locked.
+  void xattr_cache::erase(std::map<std::string, list_type::iterator>::iterator i) {
+    bytes_ -= i->second->data().size();
+    list_.erase(i->second);
+    map_.erase(i);
+  }
+}